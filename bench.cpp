@@ -0,0 +1,856 @@
+/*
+ * Microbenchmarks for json11.
+ *
+ * Build with `make bench`, or configure CMake with -DJSON11_BUILD_BENCHMARKS=ON, then run
+ * the binary with no arguments to run every benchmark, or with benchmark names to run only those.
+ * Each benchmark reports the best of several runs, next to a baseline where one makes sense.
+ */
+#include "json11.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace json11;
+using std::string;
+using std::vector;
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Allocation accounting
+ *
+ * Global operator new and delete are replaced to keep a count of live heap bytes, so that
+ * benchmarks can report the memory held by a parsed tree. The count is atomic, as the threaded
+ * benchmarks allocate and free from several threads at once.
+ */
+
+static std::atomic<size_t> live_bytes(0);
+
+void *operator new(size_t size) {
+    // Store the size in front of the block, keeping the block maximally aligned.
+    void *block = malloc(size + sizeof(std::max_align_t));
+    if (!block)
+        abort();
+    *static_cast<size_t *>(block) = size;
+    live_bytes.fetch_add(size, std::memory_order_relaxed);
+    return static_cast<char *>(block) + sizeof(std::max_align_t);
+}
+
+void operator delete(void *p) noexcept {
+    if (!p)
+        return;
+    void *block = static_cast<char *>(p) - sizeof(std::max_align_t);
+    live_bytes.fetch_sub(*static_cast<size_t *>(block), std::memory_order_relaxed);
+    free(block);
+}
+
+/* best_seconds(f, runs)
+ *
+ * Call f runs times and return the fastest run, in seconds.
+ */
+template <typename F>
+static double best_seconds(F f, int runs = 5) {
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best;
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Serialization
+ */
+
+// A number-heavy payload: a mix of short decimals, as produced by sensors and metrics, and
+// arbitrary doubles that need all 17 digits.
+static Json::array number_array(size_t count) {
+    std::mt19937_64 rng(42);
+    Json::array values;
+    values.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        if (i % 4 == 3) {
+            values.push_back(std::ldexp(static_cast<double>(rng() >> 11), -53) * 1e6);
+        } else {
+            values.push_back(static_cast<double>(rng() % 2000000) / 1000.0 - 1000.0);
+        }
+    }
+    return values;
+}
+
+// How dump() formatted doubles before it produced the shortest round-trip form.
+static void dump_with_printf(const Json::array &values, string &out) {
+    out += "[";
+    bool first = true;
+    for (const auto &value : values) {
+        if (!first)
+            out += ", ";
+        char buf[32];
+        snprintf(buf, sizeof buf, "%.17g", value.number_value());
+        out += buf;
+        first = false;
+    }
+    out += "]";
+}
+
+static void bench_dump_doubles() {
+    const Json::array values = number_array(1000000);
+    const Json json = values;
+
+    string out;
+    const double seconds = best_seconds([&] { out.clear(); json.dump(out); });
+    string baseline_out;
+    const double baseline_seconds = best_seconds([&] {
+        baseline_out.clear();
+        dump_with_printf(values, baseline_out);
+    });
+
+    printf("dump_doubles: %7.1f Mvalues/s, %zu bytes (printf %%.17g: %7.1f Mvalues/s, %zu bytes)"
+           " -> %.2fx faster\n",
+           values.size() / seconds / 1e6, out.size(),
+           values.size() / baseline_seconds / 1e6, baseline_out.size(),
+           baseline_seconds / seconds);
+}
+
+// A metrics-style payload: mostly small counters, with the occasional large or negative value.
+static Json::array int_array(size_t count) {
+    std::mt19937 rng(42);
+    Json::array values;
+    values.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const int value = static_cast<int>(rng() >> 1);
+        values.push_back(i % 8 == 7 ? -value : value % 10000);
+    }
+    return values;
+}
+
+// How dump() formatted ints before the digit-pair writer.
+static void dump_ints_with_printf(const Json::array &values, string &out) {
+    out += "[";
+    bool first = true;
+    for (const auto &value : values) {
+        if (!first)
+            out += ", ";
+        char buf[32];
+        snprintf(buf, sizeof buf, "%d", value.int_value());
+        out += buf;
+        first = false;
+    }
+    out += "]";
+}
+
+static void bench_dump_ints() {
+    const Json::array values = int_array(2000000);
+    const Json json = values;
+
+    string out;
+    const double seconds = best_seconds([&] { out.clear(); json.dump(out); });
+    string baseline_out;
+    const double baseline_seconds = best_seconds([&] {
+        baseline_out.clear();
+        dump_ints_with_printf(values, baseline_out);
+    });
+
+    printf("dump_ints: %7.1f Mvalues/s (printf %%d: %7.1f Mvalues/s) -> %.2fx faster\n",
+           values.size() / seconds / 1e6, values.size() / baseline_seconds / 1e6,
+           baseline_seconds / seconds);
+}
+
+// A string-heavy payload: log lines, mostly plain text with the occasional quote, newline or
+// non-ASCII character.
+static Json::array string_array(size_t count) {
+    std::mt19937 rng(42);
+    static const char *const words[] = {
+        "request", "served", "in", "ms", "user", "\"admin\"", "path=/api/v1/items", "caf\xc3\xa9",
+        "status", "200", "cache", "miss", "\n", "upstream", "\xe2\x82\xac", "timeout",
+    };
+    Json::array values;
+    values.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        string line;
+        const size_t length = 10 + rng() % 40;
+        for (size_t w = 0; w < length; w++) {
+            line += words[rng() % (sizeof words / sizeof words[0])];
+            line += ' ';
+        }
+        values.push_back(line);
+    }
+    return values;
+}
+
+// How dump() escaped strings before the bulk-append scan: one branch chain and append per byte.
+static void dump_string_bytewise(const string &value, string &out) {
+    out += '"';
+    for (size_t i = 0; i < value.length(); i++) {
+        const char ch = value[i];
+        if (ch == '\\') {
+            out += "\\\\";
+        } else if (ch == '"') {
+            out += "\\\"";
+        } else if (ch == '\b') {
+            out += "\\b";
+        } else if (ch == '\f') {
+            out += "\\f";
+        } else if (ch == '\n') {
+            out += "\\n";
+        } else if (ch == '\r') {
+            out += "\\r";
+        } else if (ch == '\t') {
+            out += "\\t";
+        } else if (static_cast<uint8_t>(ch) <= 0x1f) {
+            char buf[8];
+            snprintf(buf, sizeof buf, "\\u%04x", ch);
+            out += buf;
+        } else if (static_cast<uint8_t>(ch) == 0xe2 && static_cast<uint8_t>(value[i+1]) == 0x80
+                   && static_cast<uint8_t>(value[i+2]) == 0xa8) {
+            out += "\\u2028";
+            i += 2;
+        } else if (static_cast<uint8_t>(ch) == 0xe2 && static_cast<uint8_t>(value[i+1]) == 0x80
+                   && static_cast<uint8_t>(value[i+2]) == 0xa9) {
+            out += "\\u2029";
+            i += 2;
+        } else {
+            out += ch;
+        }
+    }
+    out += '"';
+}
+
+static void bench_dump_strings() {
+    const Json::array values = string_array(200000);
+    const Json json = values;
+
+    string out;
+    const double seconds = best_seconds([&] { out.clear(); json.dump(out); });
+    string baseline_out;
+    const double baseline_seconds = best_seconds([&] {
+        baseline_out.clear();
+        baseline_out += "[";
+        for (size_t i = 0; i < values.size(); i++) {
+            if (i)
+                baseline_out += ", ";
+            dump_string_bytewise(values[i].string_value(), baseline_out);
+        }
+        baseline_out += "]";
+    });
+
+    printf("dump_strings: %7.1f MB/s (bytewise: %7.1f MB/s) -> %.2fx faster\n",
+           out.size() / seconds / 1e6, baseline_out.size() / baseline_seconds / 1e6,
+           baseline_seconds / seconds);
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Building and copying values
+ */
+
+static void bench_parse_numbers() {
+    const string in = Json(number_array(1000000)).dump();
+
+    string err;
+    const double seconds = best_seconds([&] { Json::parse(in, err); });
+    printf("parse_numbers: %7.1f MB/s, %7.1f Mvalues/s\n",
+           in.size() / seconds / 1e6, 1000000 / seconds / 1e6);
+}
+
+// A typical API payload: an array of small records with strings, numbers and a nested array.
+static string records_json(size_t count) {
+    Json::array records;
+    for (size_t i = 0; i < count; i++) {
+        records.push_back(Json::object {
+            { "id", static_cast<int>(i) },
+            { "name", "user" + std::to_string(i) },
+            { "email", "user" + std::to_string(i) + "@example.com" },
+            { "score", static_cast<double>(i) / 7.0 },
+            { "active", i % 3 != 0 },
+            { "tags", Json::array { "a", "bb", "ccc" } },
+        });
+    }
+    return Json(records).dump();
+}
+
+static void bench_parse_document() {
+    const string in = records_json(1000);
+
+    string err;
+    const double seconds = best_seconds([&] { Json::parse(in, err); }, 50);
+    Json::Document doc;
+    const double document_seconds = best_seconds([&] { doc.parse(in, err); }, 50);
+    printf("parse_document: %7.1f MB/s (Json::parse: %7.1f MB/s) -> %.2fx faster\n",
+           in.size() / document_seconds / 1e6, in.size() / seconds / 1e6,
+           seconds / document_seconds);
+}
+
+// Re-indent compact JSON four spaces per level, one member or element per line, as
+// configuration files and pretty-printed API responses are.
+static string indented(const string &compact) {
+    string out;
+    size_t depth = 0;
+    bool in_string = false;
+    for (size_t i = 0; i < compact.size(); i++) {
+        const char ch = compact[i];
+        if (in_string) {
+            out += ch;
+            if (ch == '\\')
+                out += compact[++i];
+            else if (ch == '"')
+                in_string = false;
+        } else if (ch == '{' || ch == '[') {
+            out += ch;
+            out += '\n';
+            out.append(4 * ++depth, ' ');
+        } else if (ch == '}' || ch == ']') {
+            out += '\n';
+            out.append(4 * --depth, ' ');
+            out += ch;
+        } else if (ch == ',') {
+            out += ",\n";
+            out.append(4 * depth, ' ');
+        } else if (ch != ' ') {
+            in_string = (ch == '"');
+            out += ch;
+        } else if (compact[i - 1] == ':') {
+            out += ' ';
+        }
+    }
+    return out;
+}
+
+// The same document compact and indented: the time spent on the indentation is the difference.
+static void bench_parse_indented() {
+    Json::array values;
+    for (int i = 0; i < 1000000; i++)
+        values.push_back(i % 1000);
+    const string compact = Json(Json::object { { "values", values } }).dump();
+    const string pretty = indented(compact);
+
+    string err;
+    const double compact_seconds = best_seconds([&] { Json::parse(compact, err); }, 15);
+    const double seconds = best_seconds([&] { Json::parse(pretty, err); }, 15);
+    printf("parse_indented: %7.1f MB/s, %6.2f ms (compact: %7.1f MB/s, %6.2f ms)"
+           " -> whitespace adds %.0f%%\n",
+           pretty.size() / seconds / 1e6, seconds * 1e3,
+           compact.size() / compact_seconds / 1e6, compact_seconds * 1e3,
+           100 * (seconds / compact_seconds - 1));
+}
+
+// Look up each key of each record (plus one that is missing), through Json::operator[] and
+// through the std::map returned by object_items().
+static void bench_lookup_keys() {
+    string err;
+    const Json records = Json::parse(records_json(1000), err);
+    static const string keys[] = { "id", "name", "email", "score", "active", "tags", "missing" };
+
+    double sum = 0;
+    const double seconds = best_seconds([&] {
+        for (const auto &record : records.array_items()) {
+            for (const auto &key : keys)
+                sum += record[key].number_value();
+        }
+    }, 50);
+    const double map_seconds = best_seconds([&] {
+        for (const auto &record : records.array_items()) {
+            const Json::object &items = record.object_items();
+            for (const auto &key : keys) {
+                const auto it = items.find(key);
+                if (it != items.end())
+                    sum += it->second.number_value();
+            }
+        }
+    }, 50);
+    const double lookups = 7.0 * records.array_items().size();
+    printf("lookup_keys: %7.1f Mlookups/s (std::map: %7.1f Mlookups/s) -> %.2fx faster (%g)\n",
+           lookups / seconds / 1e6, lookups / map_seconds / 1e6, map_seconds / seconds, sum);
+}
+
+// Look up fields by string literal, as request handlers do, against what that cost when each
+// literal had to be turned into a std::string first.
+static void bench_lookup_literals() {
+    string err;
+    const Json records = Json::parse(records_json(1000), err);
+
+    double sum = 0;
+    const double seconds = best_seconds([&] {
+        for (const auto &record : records.array_items()) {
+            sum += record["id"].number_value() + record["score"].number_value();
+            sum += record["email"].string_ref_value().size + record["missing"].number_value();
+        }
+    }, 50);
+    const double temporary_seconds = best_seconds([&] {
+        for (const auto &record : records.array_items()) {
+            sum += record[string("id")].number_value() + record[string("score")].number_value();
+            sum += record[string("email")].string_ref_value().size
+                   + record[string("missing")].number_value();
+        }
+    }, 50);
+    const double lookups = 4.0 * records.array_items().size();
+    printf("lookup_literals: %7.1f Mlookups/s (via std::string: %7.1f Mlookups/s)"
+           " -> %.2fx faster (%g)\n",
+           lookups / seconds / 1e6, lookups / temporary_seconds / 1e6,
+           temporary_seconds / seconds, sum);
+}
+
+// Look up every key of a 100k-key lookup table, with and without a hash index.
+static void bench_lookup_wide() {
+    Json::object table;
+    vector<string> keys;
+    for (int i = 0; i < 100000; i++) {
+        keys.push_back("feature:" + std::to_string(i * 7919 % 1000003));
+        table[keys.back()] = i;
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    const string in = Json(table).dump();
+
+    string err;
+    const Json sorted = Json::parse(in, err);
+    ParseOptions options;
+    options.object_index_threshold = 64;
+    const Json hashed = Json::parse(in, err, options);
+
+    double sum = 0;
+    const double sorted_seconds = best_seconds([&] {
+        for (const auto &key : keys)
+            sum += sorted[key].number_value();
+    });
+    const double hashed_seconds = best_seconds([&] {
+        for (const auto &key : keys)
+            sum += hashed[key].number_value();
+    });
+    printf("lookup_wide: %7.1f Mlookups/s (binary search: %7.1f Mlookups/s) -> %.2fx faster (%g)\n",
+           keys.size() / hashed_seconds / 1e6, keys.size() / sorted_seconds / 1e6,
+           sorted_seconds / hashed_seconds, sum);
+}
+
+// Read ten fields from each of a stream of 24-field messages, through prepared Json::Keys and
+// through string literals.
+static void bench_lookup_key_handles() {
+    Json::array messages;
+    for (int i = 0; i < 10000; i++) {
+        Json::object message;
+        for (int field = 0; field < 24; field++)
+            message["field_" + std::to_string(field)] = i + field;
+        messages.push_back(message);
+    }
+    string err;
+    const Json stream = Json::parse(Json(messages).dump(), err);
+
+    static const char *const names[] = { "field_0", "field_3", "field_5", "field_8", "field_11",
+                                         "field_13", "field_17", "field_19", "field_22", "field_23" };
+    vector<Json::Key> keys;
+    for (const char *name : names)
+        keys.emplace_back(name);
+
+    double sum = 0;
+    const double key_seconds = best_seconds([&] {
+        for (const auto &message : stream.array_items()) {
+            for (const auto &key : keys)
+                sum += message[key].number_value();
+        }
+    }, 50);
+    const double literal_seconds = best_seconds([&] {
+        for (const auto &message : stream.array_items()) {
+            for (const char *name : names)
+                sum += message[name].number_value();
+        }
+    }, 50);
+    const double lookups = 10.0 * stream.array_items().size();
+    printf("lookup_key_handles: %7.1f Mlookups/s (string literals: %7.1f Mlookups/s)"
+           " -> %.2fx faster (%g)\n",
+           lookups / key_seconds / 1e6, lookups / literal_seconds / 1e6,
+           literal_seconds / key_seconds, sum);
+}
+
+// Log records whose messages are mostly plain text, a few with escapes.
+static string log_records_json(size_t count) {
+    Json::array records;
+    for (size_t i = 0; i < count; i++) {
+        string message = "GET /api/v1/items/" + std::to_string(i) + " served from cache in "
+                         + std::to_string(i % 97) + "ms for client 10.0.0." + std::to_string(i % 255);
+        if (i % 20 == 0)
+            message += "\n\tretried after \"timeout\"";
+        records.push_back(Json::object {
+            { "level", "info" },
+            { "message", message },
+            { "trace", "4bf92f3577b34da6a3ce929d0e0e" + std::to_string(4736 + i) },
+        });
+    }
+    return Json(records).dump();
+}
+
+static void bench_parse_zero_copy() {
+    const auto in = std::make_shared<const string>(log_records_json(20000));
+    ParseOptions zero_copy;
+    zero_copy.zero_copy_strings = true;
+
+    string err;
+    const double seconds = best_seconds([&] { Json::parse(*in, err); });
+    const double zero_copy_seconds = best_seconds([&] { Json::parse(in, err, zero_copy); });
+
+    size_t before = live_bytes.load();
+    Json copied = Json::parse(*in, err);
+    const size_t copied_bytes = live_bytes.load() - before;
+    before = live_bytes.load();
+    Json viewed = Json::parse(in, err, zero_copy);
+    const size_t viewed_bytes = live_bytes.load() - before;
+
+    printf("parse_zero_copy: %7.1f MB/s, %zu bytes held (copying: %7.1f MB/s, %zu bytes held)"
+           " -> %.2fx faster\n",
+           in->size() / zero_copy_seconds / 1e6, viewed_bytes, in->size() / seconds / 1e6,
+           copied_bytes, seconds / zero_copy_seconds);
+}
+
+// Records whose field names are too long to be stored inline in each object.
+static void bench_parse_interned_keys() {
+    Json::array records;
+    for (int i = 0; i < 100000; i++) {
+        records.push_back(Json::object {
+            { "customer_account_identifier", i },
+            { "billing_address_country_code", "NZ" },
+            { "last_successful_login_timestamp", i * 60 },
+            { "preferred_contact_channel_name", "email" },
+        });
+    }
+    const string in = Json(records).dump();
+    ParseOptions interned;
+    interned.intern_keys = true;
+
+    string err;
+    const double seconds = best_seconds([&] { Json::parse(in, err); }, 10);
+    const double interned_seconds = best_seconds([&] { Json::parse(in, err, interned); }, 10);
+
+    size_t before = live_bytes.load();
+    Json copied = Json::parse(in, err);
+    const size_t copied_bytes = live_bytes.load() - before;
+    before = live_bytes.load();
+    Json shared = Json::parse(in, err, interned);
+    const size_t interned_bytes = live_bytes.load() - before;
+
+    printf("parse_interned_keys: %7.1f MB/s, %zu bytes held (own keys: %7.1f MB/s, %zu bytes held)"
+           " -> %.2fx faster\n",
+           in.size() / interned_seconds / 1e6, interned_bytes, in.size() / seconds / 1e6,
+           copied_bytes, seconds / interned_seconds);
+}
+
+static void bench_parse_deduped() {
+    // A config snapshot: many services, most of them with the same settings.
+    Json::array services;
+    for (int i = 0; i < 20000; i++) {
+        services.push_back(Json::object {
+            { "name", "service-" + std::to_string(i) },
+            { "region", i % 3 ? "eu-west" : "us-east" },
+            { "limits", Json::object { { "cpu", 2 }, { "memory", i % 10 ? 512 : 1024 } } },
+            { "retry", Json::object { { "attempts", 3 }, { "backoff", Json::array { 1, 2, 4 } } } },
+            { "tags", Json::array { "managed", "tier-" + std::to_string(i % 4) } },
+        });
+    }
+    const string in = Json(services).dump();
+    ParseOptions deduped;
+    deduped.dedupe_values = true;
+
+    string err;
+    const Json parsed = Json::parse(in, err);
+    const double seconds = best_seconds([&] { Json::parse(in, err); }, 10);
+    const double deduped_seconds = best_seconds([&] { Json::parse(in, err, deduped); }, 10);
+    const double dedupe_seconds = best_seconds([&] { parsed.dedupe(); }, 10);
+
+    size_t before = live_bytes.load();
+    Json copied = Json::parse(in, err);
+    const size_t copied_bytes = live_bytes.load() - before;
+    before = live_bytes.load();
+    Json shared = Json::parse(in, err, deduped);
+    const size_t deduped_bytes = live_bytes.load() - before;
+
+    printf("parse_deduped: %7.1f MB/s, %zu bytes held (plain: %7.1f MB/s, %zu bytes held;"
+           " dedupe(): %7.1f MB/s)\n",
+           in.size() / deduped_seconds / 1e6, deduped_bytes, in.size() / seconds / 1e6,
+           copied_bytes, in.size() / dedupe_seconds / 1e6);
+}
+
+static void bench_parse_number_arrays() {
+    // Embeddings: records that each carry a long vector of doubles.
+    const Json::array numbers = number_array(512);
+    Json::array records;
+    for (int i = 0; i < 2000; i++)
+        records.push_back(Json::object { { "id", i }, { "embedding", numbers } });
+    const string in = Json(records).dump();
+    ParseOptions as_json;
+    as_json.number_array_threshold = 0;
+
+    string err;
+    const double seconds = best_seconds([&] { Json::parse(in, err); });
+    const double json_seconds = best_seconds([&] { Json::parse(in, err, as_json); });
+
+    size_t before = live_bytes.load();
+    const Json contiguous = Json::parse(in, err);
+    const size_t contiguous_bytes = live_bytes.load() - before;
+    before = live_bytes.load();
+    const Json elements = Json::parse(in, err, as_json);
+    const size_t element_bytes = live_bytes.load() - before;
+
+    // Sum every vector, through number_span_value() and through array_items().
+    double span_sum = 0, items_sum = 0;
+    const double span_seconds = best_seconds([&] {
+        span_sum = 0;
+        for (const Json &record : contiguous.array_items())
+            for (double value : record["embedding"].number_span_value())
+                span_sum += value;
+    });
+    const double items_seconds = best_seconds([&] {
+        items_sum = 0;
+        for (const Json &record : elements.array_items())
+            for (const Json &value : record["embedding"].array_items())
+                items_sum += value.number_value();
+    });
+    if (span_sum != items_sum)
+        abort();
+    printf("parse_number_arrays: %7.1f MB/s, %zu bytes held, summed at %7.1f Mvalues/s"
+           " (as Json elements: %7.1f MB/s, %zu bytes held, %7.1f Mvalues/s)\n",
+           in.size() / seconds / 1e6, contiguous_bytes, 2000 * 512 / span_seconds / 1e6,
+           in.size() / json_seconds / 1e6, element_bytes, 2000 * 512 / items_seconds / 1e6);
+}
+
+static void bench_copy_numbers() {
+    const Json::array values = number_array(1000000);
+
+    const double seconds = best_seconds([&] { Json::array copy = values; });
+    printf("copy_numbers: %7.1f Mvalues/s\n", values.size() / seconds / 1e6);
+}
+
+static void bench_read_fields() {
+    // Records as a tight loop sees them: read each one's fields and accumulate.
+    Json::array records;
+    for (int i = 0; i < 1000000; i++)
+        records.push_back(Json::array { i, i * 0.25, i % 3 == 0 });
+
+    double total = 0;
+    const double seconds = best_seconds([&] {
+        double sum = 0;
+        for (const Json &record : records) {
+            const Json::array &fields = record.array_items();
+            if (fields[2].bool_value())
+                sum += fields[0].int_value() + fields[1].number_value();
+        }
+        total = sum;
+    });
+    printf("read_fields: %7.1f Mrecords/s (total %g)\n", records.size() / seconds / 1e6, total);
+}
+
+// Hash a tree with visit().
+struct HashVisitor {
+    uint64_t operator()(std::nullptr_t) const { return 1; }
+    uint64_t operator()(bool value) const { return 2 + value; }
+    uint64_t operator()(int value) const { return 4 + static_cast<uint64_t>(value) * 31; }
+    uint64_t operator()(double value) const { return 5 + static_cast<uint64_t>(value); }
+    uint64_t operator()(Json::string_ref value) const { return 6 + value.size; }
+    uint64_t operator()(const Json::array &items) const {
+        uint64_t h = 7;
+        for (const Json &item : items)
+            h = h * 31 + item.visit(*this);
+        return h;
+    }
+    uint64_t operator()(Json::object_ref members) const {
+        uint64_t h = 8;
+        for (size_t i = 0; i < members.size(); i++)
+            h = h * 31 + members.key(i).size + members.value(i).visit(*this);
+        return h;
+    }
+};
+
+// The same hash, with type() and the accessors.
+static uint64_t hash_by_type(const Json &value) {
+    switch (value.type()) {
+    case Json::NUL:
+        return 1;
+    case Json::BOOL:
+        return 2 + value.bool_value();
+    case Json::NUMBER:
+        if (value.number_value() == value.int_value())
+            return 4 + static_cast<uint64_t>(value.int_value()) * 31;
+        return 5 + static_cast<uint64_t>(value.number_value());
+    case Json::STRING:
+        return 6 + value.string_value().size();
+    case Json::ARRAY: {
+        uint64_t h = 7;
+        for (const Json &item : value.array_items())
+            h = h * 31 + hash_by_type(item);
+        return h;
+    }
+    case Json::OBJECT: {
+        uint64_t h = 8;
+        for (const auto &member : value.object_items())
+            h = h * 31 + member.first.size() + hash_by_type(member.second);
+        return h;
+    }
+    }
+    return 0;
+}
+
+static void bench_visit_tree() {
+    const string in = records_json(100000);
+    string err;
+    const Json tree = Json::parse(in, err);
+
+    uint64_t visited = 0, typed = 0;
+    const double seconds = best_seconds([&] { visited = tree.visit(HashVisitor()); });
+    const double typed_seconds = best_seconds([&] { typed = hash_by_type(tree); });
+    if (visited != typed)
+        abort();
+    printf("visit_tree: %7.1f MB/s (type() and accessors: %7.1f MB/s) -> %.2fx faster\n",
+           in.size() / seconds / 1e6, in.size() / typed_seconds / 1e6, typed_seconds / seconds);
+}
+
+static void bench_copy_values() {
+    // Few enough nodes to stay in cache, so that the reference counts are what is measured.
+    Json::array values, others;
+    for (int i = 0; i < 1000; i++) {
+        values.push_back(i % 2 ? Json(std::to_string(i)) : Json(Json::array { i }));
+        others.push_back(Json(Json::array { i }));
+    }
+    Json::array copy(values.size());
+
+    // The reference counts of a program with more than one thread, even if this one is the
+    // only one that uses Json.
+    std::thread([] {}).join();
+
+    // Each assignment takes a reference to one node and drops a reference to another.
+    const int rounds = 500;
+    const double seconds = best_seconds([&] {
+        for (int round = 0; round < rounds; round++) {
+            std::copy(values.begin(), values.end(), copy.begin());
+            std::copy(others.begin(), others.end(), copy.begin());
+        }
+    });
+    printf("copy_values: %7.1f Mvalues/s (%s reference counts)\n",
+           2 * rounds * values.size() / seconds / 1e6,
+           JSON11_SINGLE_THREADED ? "single-threaded" : "atomic");
+}
+
+/* per_thread_rate(threads, iterations, f)
+ *
+ * Run f(iterations) on the given number of threads at once, and return the iterations per
+ * second that each managed (the best of three runs). Scaling is perfect if this doesn't drop as
+ * threads are added, up to the number of cores.
+ */
+template <typename F>
+static double per_thread_rate(unsigned threads, int iterations, F f) {
+    const double seconds = best_seconds([&] {
+        vector<std::thread> workers;
+        for (unsigned i = 0; i < threads; i++)
+            workers.emplace_back(f, iterations);
+        for (auto &worker : workers)
+            worker.join();
+    }, 3);
+    return iterations / seconds;
+}
+
+static void bench_constants_threads() {
+    // Null and booleans are held inline, so building and dropping them touches no shared
+    // memory. Copies of one string, for contrast, all update the same reference count.
+    const Json shared("shared");
+    const int iterations = 2000000;
+    const unsigned max_threads = std::max(4u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        const double constants = per_thread_rate(threads, iterations, [](int n) {
+            int count = 0;
+            for (int i = 0; i < n; i++) {
+                const Json values[] = { Json(), Json(nullptr), Json(i % 2 == 0) };
+                for (const Json &value : values)
+                    count += value.is_null() + value.bool_value();
+            }
+            if (count != n + n / 2 + n % 2 + n)
+                abort();
+        });
+        printf("constants_threads: %2u threads, %7.1f Mconstants/s each",
+               threads, 3 * constants / 1e6);
+        // With non-atomic reference counts, copying one string on several threads is a race.
+        if (JSON11_SINGLE_THREADED) {
+            printf(" (copies of one string: skipped, single-threaded reference counts)\n");
+            continue;
+        }
+        const double copies = per_thread_rate(threads, iterations, [&](int n) {
+            for (int i = 0; i < n; i++)
+                Json copy = shared;
+        });
+        printf(" (copies of one string: %7.1f M/s each)\n", copies / 1e6);
+    }
+}
+
+static void bench_drop_tree() {
+    // The time the caller spends letting go of a large tree: freeing it there and then, or
+    // handing it to a JsonFreeQueue drained by another thread. Each run waits for the queue to
+    // be drained before building the next tree, so that the two threads never allocate at once.
+    const string in = records_json(100000);
+    string err;
+    double release_seconds = 1e30, push_seconds = 1e30;
+    for (int run = 0; run < 5; run++) {
+        Json tree = Json::parse(in, err);
+        auto start = std::chrono::steady_clock::now();
+        tree = Json();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        release_seconds = std::min(release_seconds, elapsed.count());
+
+        tree = Json::parse(in, err);
+        JsonFreeQueue frees;
+        std::thread reaper([&] { while (frees.wait_and_drain()) {} });
+        start = std::chrono::steady_clock::now();
+        frees.push(std::move(tree));
+        elapsed = std::chrono::steady_clock::now() - start;
+        push_seconds = std::min(push_seconds, elapsed.count());
+        frees.close();
+        reaper.join();
+    }
+    printf("drop_tree: %.1f MB tree, freed by the caller in %7.2f ms, pushed to a queue in"
+           " %7.2f us\n", in.size() / 1e6, release_seconds * 1e3, push_seconds * 1e6);
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Driver
+ */
+
+static const struct {
+    const char *name;
+    void (*run)();
+} benchmarks[] = {
+    { "dump_doubles", bench_dump_doubles },
+    { "dump_ints", bench_dump_ints },
+    { "dump_strings", bench_dump_strings },
+    { "parse_numbers", bench_parse_numbers },
+    { "copy_numbers", bench_copy_numbers },
+    { "read_fields", bench_read_fields },
+    { "visit_tree", bench_visit_tree },
+    { "parse_document", bench_parse_document },
+    { "parse_indented", bench_parse_indented },
+    { "lookup_keys", bench_lookup_keys },
+    { "lookup_literals", bench_lookup_literals },
+    { "lookup_wide", bench_lookup_wide },
+    { "lookup_key_handles", bench_lookup_key_handles },
+    { "parse_zero_copy", bench_parse_zero_copy },
+    { "parse_interned_keys", bench_parse_interned_keys },
+    { "parse_deduped", bench_parse_deduped },
+    { "parse_number_arrays", bench_parse_number_arrays },
+    // These start threads, which makes reference counting dearer for the rest of the process.
+    { "copy_values", bench_copy_values },
+    { "constants_threads", bench_constants_threads },
+    { "drop_tree", bench_drop_tree },
+};
+
+int main(int argc, char **argv) {
+    for (const auto &benchmark : benchmarks) {
+        bool selected = (argc == 1);
+        for (int i = 1; i < argc; i++)
+            selected |= (std::strcmp(argv[i], benchmark.name) == 0);
+        if (selected)
+            benchmark.run();
+    }
+    return 0;
+}
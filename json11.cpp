@@ -24,11 +24,28 @@
 #include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <clocale>
+#include <cfloat>
 #include <limits>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <type_traits>
+#include <new>
 
-namespace json11 {
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define JSON11_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
 
-static const int max_depth = 200;
+namespace json11 {
 
 using std::string;
 using std::vector;
@@ -37,47 +54,536 @@ using std::make_shared;
 using std::initializer_list;
 using std::move;
 
-/* Helper for representing null - just a do-nothing struct, plus comparison
- * operators so the helpers in JsonValue work. We can't use nullptr_t because
- * it may not be orderable.
+// Index of the lowest set bit of x, which must not be zero.
+static inline int trailing_zeroes(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long r;
+    _BitScanForward64(&r, x);
+    return static_cast<int>(r);
+#else
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Serialization
+ */
+
+/* ObjectKey
+ *
+ * An object key: the size of a std::string, but with room for 24 bytes inline rather than 15,
+ * which covers nearly all keys without an allocation. Longer keys are either allocated or, if
+ * interned (see KeyTable), a view of storage that the object keeps alive.
  */
-struct NullStruct {
-    bool operator==(NullStruct) const { return true; }
-    bool operator<(NullStruct) const { return false; }
+class ObjectKey final {
+public:
+    static const size_t inline_capacity = 24;
+
+    ObjectKey(const char *data, size_t size) : m_size(size) {
+        if (size <= inline_capacity) {
+            if (size)
+                memcpy(m_text.chars, data, size);
+        } else {
+            char *copy = new char[size];
+            memcpy(copy, data, size);
+            m_text.heap = { copy, true };
+        }
+    }
+    // A view of the size chars at data, which must outlive the key if they don't fit inline.
+    static ObjectKey view(const char *data, size_t size) {
+        if (size <= inline_capacity)
+            return ObjectKey(data, size);
+        ObjectKey key;
+        key.m_size = size;
+        key.m_text.heap = { data, false };
+        return key;
+    }
+
+    ObjectKey(const ObjectKey &other) : m_size(other.m_size), m_text(other.m_text) {
+        if (owned()) {
+            char *copy = new char[m_size];
+            memcpy(copy, other.m_text.heap.data, m_size);
+            m_text.heap.data = copy;
+        }
+    }
+    ObjectKey(ObjectKey &&other) noexcept : m_size(other.m_size), m_text(other.m_text) {
+        other.m_size = 0;
+    }
+    ObjectKey & operator=(ObjectKey &&other) noexcept {
+        if (this != &other) {
+            release();
+            m_size = other.m_size;
+            m_text = other.m_text;
+            other.m_size = 0;
+        }
+        return *this;
+    }
+    ObjectKey & operator=(const ObjectKey &) = delete;
+    ~ObjectKey() { release(); }
+
+    const char *data() const { return m_size <= inline_capacity ? m_text.chars : m_text.heap.data; }
+    size_t size() const { return m_size; }
+    operator Json::string_ref() const { return Json::string_ref(data(), m_size); }
+
+    bool operator==(const ObjectKey &other) const {
+        return m_size == other.m_size && memcmp(data(), other.data(), m_size) == 0;
+    }
+    bool operator<(const ObjectKey &other) const {
+        const int order = memcmp(data(), other.data(), std::min(m_size, other.m_size));
+        return order < 0 || (order == 0 && m_size < other.m_size);
+    }
+
+private:
+    ObjectKey() : m_size(0) {}
+
+    bool owned() const { return m_size > inline_capacity && m_text.heap.owned; }
+    void release() {
+        if (owned())
+            delete[] m_text.heap.data;
+    }
+
+    size_t m_size;
+    union Text {
+        char chars[inline_capacity];
+        struct {
+            const char *data;
+            bool owned;
+        } heap;
+    } m_text;
 };
 
+// The key-value pairs of an object, sorted by key with no duplicates; see JsonObject.
+typedef vector<std::pair<ObjectKey, Json>> ObjectEntries;
+
 /* * * * * * * * * * * * * * * * * * * *
- * Serialization
+ * Double formatting
+ *
+ * Doubles are printed with the fewest digits that still read back as the same value (so 0.1
+ * comes out as "0.1", not "0.10000000000000001"), using the Grisu2 algorithm by Florian
+ * Loitsch: the value and the boundaries of its rounding interval are scaled by a cached power
+ * of ten into 64-bit fixed point, and digits are generated until the result is inside the
+ * interval. Grisu2 always round-trips; in rare cases it gives one digit more than the
+ * shortest possible. The layout matches printf's "%.17g", independent of the locale.
+ */
+
+namespace {
+struct DiyFp {
+    uint64_t f;
+    int e;
+
+    DiyFp(uint64_t f, int e) : f(f), e(e) {}
+
+    DiyFp operator-(const DiyFp &y) const { return DiyFp(f - y.f, e); }
+
+    // Upper 64 bits of the product, rounded.
+    DiyFp operator*(const DiyFp &y) const {
+        const uint64_t u_lo = f & 0xFFFFFFFF, u_hi = f >> 32;
+        const uint64_t v_lo = y.f & 0xFFFFFFFF, v_hi = y.f >> 32;
+        const uint64_t p0 = u_lo * v_lo, p1 = u_lo * v_hi, p2 = u_hi * v_lo, p3 = u_hi * v_hi;
+        uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFF) + (p2 & 0xFFFFFFFF);
+        q += uint64_t(1) << 31;
+        return DiyFp(p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32), e + y.e + 64);
+    }
+
+    DiyFp normalized() const {
+        DiyFp x = *this;
+        while ((x.f >> 63) == 0) {
+            x.f <<= 1;
+            x.e--;
+        }
+        return x;
+    }
+};
+
+struct CachedPower {
+    uint64_t f;
+    int e;
+    int k;
+};
+}//namespace {
+
+// Normalized, correctly rounded 10^k for k = -300, -292, ..., 340.
+static const CachedPower cached_powers[] = {
+    { 0xAB70FE17C79AC6CA, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+    { 0xBE5691EF416BD60C, -1007, -284 },
+    { 0x8DD01FAD907FFC3C,  -980, -276 },
+    { 0xD3515C2831559A83,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5,  -927, -260 },
+    { 0xEA9C227723EE8BCB,  -901, -252 },
+    { 0xAECC49914078536D,  -874, -244 },
+    { 0x823C12795DB6CE57,  -847, -236 },
+    { 0xC21094364DFB5637,  -821, -228 },
+    { 0x9096EA6F3848984F,  -794, -220 },
+    { 0xD77485CB25823AC7,  -768, -212 },
+    { 0xA086CFCD97BF97F4,  -741, -204 },
+    { 0xEF340A98172AACE5,  -715, -196 },
+    { 0xB23867FB2A35B28E,  -688, -188 },
+    { 0x84C8D4DFD2C63F3B,  -661, -180 },
+    { 0xC5DD44271AD3CDBA,  -635, -172 },
+    { 0x936B9FCEBB25C996,  -608, -164 },
+    { 0xDBAC6C247D62A584,  -582, -156 },
+    { 0xA3AB66580D5FDAF6,  -555, -148 },
+    { 0xF3E2F893DEC3F126,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8,  -502, -132 },
+    { 0x87625F056C7C4A8B,  -475, -124 },
+    { 0xC9BCFF6034C13053,  -449, -116 },
+    { 0x964E858C91BA2655,  -422, -108 },
+    { 0xDFF9772470297EBD,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+    { 0xF8A95FCF88747D94,  -343,  -84 },
+    { 0xB94470938FA89BCF,  -316,  -76 },
+    { 0x8A08F0F8BF0F156B,  -289,  -68 },
+    { 0xCDB02555653131B6,  -263,  -60 },
+    { 0x993FE2C6D07B7FAC,  -236,  -52 },
+    { 0xE45C10C42A2B3B06,  -210,  -44 },
+    { 0xAA242499697392D3,  -183,  -36 },
+    { 0xFD87B5F28300CA0E,  -157,  -28 },
+    { 0xBCE5086492111AEB,  -130,  -20 },
+    { 0x8CBCCC096F5088CC,  -103,  -12 },
+    { 0xD1B71758E219652C,   -77,   -4 },
+    { 0x9C40000000000000,   -50,    4 },
+    { 0xE8D4A51000000000,   -24,   12 },
+    { 0xAD78EBC5AC620000,     3,   20 },
+    { 0x813F3978F8940984,    30,   28 },
+    { 0xC097CE7BC90715B3,    56,   36 },
+    { 0x8F7E32CE7BEA5C70,    83,   44 },
+    { 0xD5D238A4ABE98068,   109,   52 },
+    { 0x9F4F2726179A2245,   136,   60 },
+    { 0xED63A231D4C4FB27,   162,   68 },
+    { 0xB0DE65388CC8ADA8,   189,   76 },
+    { 0x83C7088E1AAB65DB,   216,   84 },
+    { 0xC45D1DF942711D9A,   242,   92 },
+    { 0x924D692CA61BE758,   269,  100 },
+    { 0xDA01EE641A708DEA,   295,  108 },
+    { 0xA26DA3999AEF774A,   322,  116 },
+    { 0xF209787BB47D6B85,   348,  124 },
+    { 0xB454E4A179DD1877,   375,  132 },
+    { 0x865B86925B9BC5C2,   402,  140 },
+    { 0xC83553C5C8965D3D,   428,  148 },
+    { 0x952AB45CFA97A0B3,   455,  156 },
+    { 0xDE469FBD99A05FE3,   481,  164 },
+    { 0xA59BC234DB398C25,   508,  172 },
+    { 0xF6C69A72A3989F5C,   534,  180 },
+    { 0xB7DCBF5354E9BECE,   561,  188 },
+    { 0x88FCF317F22241E2,   588,  196 },
+    { 0xCC20CE9BD35C78A5,   614,  204 },
+    { 0x98165AF37B2153DF,   641,  212 },
+    { 0xE2A0B5DC971F303A,   667,  220 },
+    { 0xA8D9D1535CE3B396,   694,  228 },
+    { 0xFB9B7CD9A4A7443C,   720,  236 },
+    { 0xBB764C4CA7A44410,   747,  244 },
+    { 0x8BAB8EEFB6409C1A,   774,  252 },
+    { 0xD01FEF10A657842C,   800,  260 },
+    { 0x9B10A4E5E9913129,   827,  268 },
+    { 0xE7109BFBA19C0C9D,   853,  276 },
+    { 0xAC2820D9623BF429,   880,  284 },
+    { 0x80444B5E7AA7CF85,   907,  292 },
+    { 0xBF21E44003ACDD2D,   933,  300 },
+    { 0x8E679C2F5E44FF8F,   960,  308 },
+    { 0xD433179D9C8CB841,   986,  316 },
+    { 0x9E19DB92B4E31BA9,  1013,  324 },
+    { 0xEB96BF6EBADF77D9,  1039,  332 },
+    { 0xAF87023B9BF0EE6B,  1066,  340 },
+};
+
+/* grisu2_round(buf, len, dist, delta, rest, ten_k)
+ *
+ * Move the last generated digit down while that brings the result closer to the exact value
+ * and keeps it inside the rounding interval.
+ */
+static inline void grisu2_round(char *buf, int len, uint64_t dist, uint64_t delta,
+                                uint64_t rest, uint64_t ten_k) {
+    while (rest < dist && delta - rest >= ten_k
+           && (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        buf[len - 1]--;
+        rest += ten_k;
+    }
+}
+
+/* grisu2(value, buf, len, decimal_exponent)
+ *
+ * Write the digits of a finite, positive double to buf (at least 17 chars) such that value
+ * reads back from buf[0, len) * 10^decimal_exponent.
  */
+static void grisu2(double value, char *buf, int &len, int &decimal_exponent) {
+    // Decompose value, and find the boundaries m- and m+ of the interval of reals that round
+    // to it. The lower boundary is closer when value is a power of two.
+    const int precision = 53, bias = 1075;
+    const uint64_t hidden_bit = uint64_t(1) << (precision - 1);
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof bits);
+    const uint64_t biased_e = bits >> (precision - 1);
+    const uint64_t fraction = bits & (hidden_bit - 1);
+    const DiyFp v = (biased_e == 0) ? DiyFp(fraction, 1 - bias)
+                                    : DiyFp(fraction + hidden_bit, static_cast<int>(biased_e) - bias);
+    const bool lower_boundary_is_closer = (fraction == 0 && biased_e > 1);
+    const DiyFp m_plus = DiyFp(2 * v.f + 1, v.e - 1).normalized();
+    DiyFp m_minus = lower_boundary_is_closer ? DiyFp(4 * v.f - 1, v.e - 2)
+                                             : DiyFp(2 * v.f - 1, v.e - 1);
+    m_minus = DiyFp(m_minus.f << (m_minus.e - m_plus.e), m_plus.e);
+    const DiyFp w = v.normalized();
+
+    // Scale by a cached 10^-k so the binary exponent of the products is in [-60, -32].
+    const int alpha = -60;
+    const int f = alpha - m_plus.e - 1;
+    const int k = (f * 78913) / (1 << 18) + static_cast<int>(f > 0);
+    const size_t index = static_cast<size_t>((300 + k + 7) / 8);
+    assert(index < sizeof cached_powers / sizeof cached_powers[0]);
+    const CachedPower &cached = cached_powers[index];
+    const DiyFp c_minus_k(cached.f, cached.e);
+    const DiyFp scaled_w = w * c_minus_k;
+    const DiyFp scaled_minus = m_minus * c_minus_k;
+    const DiyFp scaled_plus = m_plus * c_minus_k;
+    // Shrink the interval by one unit on each side to allow for the rounding of the products.
+    const DiyFp upper(scaled_plus.f - 1, scaled_plus.e);
+    const DiyFp lower(scaled_minus.f + 1, scaled_minus.e);
+    decimal_exponent = -cached.k;
+
+    // Generate digits of upper until the remainder falls inside the interval.
+    uint64_t delta = (upper - lower).f;
+    uint64_t dist = (upper - scaled_w).f;
+    const DiyFp one(uint64_t(1) << -upper.e, upper.e);
+    uint32_t p1 = static_cast<uint32_t>(upper.f >> -one.e);
+    uint64_t p2 = upper.f & (one.f - 1);
+
+    uint32_t pow10 = 1000000000;
+    int n = 10;
+    while (n > 1 && p1 < pow10) {
+        pow10 /= 10;
+        n--;
+    }
+
+    len = 0;
+    while (n > 0) {
+        buf[len++] = static_cast<char>('0' + p1 / pow10);
+        p1 %= pow10;
+        n--;
+        const uint64_t rest = (uint64_t(p1) << -one.e) + p2;
+        if (rest <= delta) {
+            decimal_exponent += n;
+            grisu2_round(buf, len, dist, delta, rest, uint64_t(pow10) << -one.e);
+            return;
+        }
+        pow10 /= 10;
+    }
 
-static void dump(NullStruct, string &out) {
-    out += "null";
+    int m = 0;
+    while (true) {
+        p2 *= 10;
+        buf[len++] = static_cast<char>('0' + (p2 >> -one.e));
+        p2 &= one.f - 1;
+        m++;
+        delta *= 10;
+        dist *= 10;
+        if (p2 <= delta)
+            break;
+    }
+    decimal_exponent -= m;
+    grisu2_round(buf, len, dist, delta, p2, one.f);
 }
 
 static void dump(double value, string &out) {
-    if (std::isfinite(value)) {
-        char buf[32];
-        snprintf(buf, sizeof buf, "%.17g", value);
-        out += buf;
-    } else {
+    if (!std::isfinite(value)) {
         out += "null";
+        return;
+    }
+    if (value == 0) {
+        out += std::signbit(value) ? "-0" : "0";
+        return;
+    }
+
+    // Room for a sign, 17 digits, a point, up to 4 zeros after it (fixed notation is only used
+    // for exponents down to -4, as in "%g") or 16 zeros before it.
+    char buf[48];
+    char *p = buf;
+    if (value < 0) {
+        *p++ = '-';
+        value = -value;
+    }
+    char digits[20];
+    int len, decimal_exponent;
+    grisu2(value, digits, len, decimal_exponent);
+
+    // The value is 0.d1d2...dlen * 10^point.
+    const int point = len + decimal_exponent;
+    if (point - 1 < -4 || point - 1 >= 17) {
+        // Scientific: d1.d2...dlen e+XX
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, len - 1);
+            p += len - 1;
+        }
+        int exponent = point - 1;
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+        if (exponent < 0)
+            exponent = -exponent;
+        if (exponent >= 100)
+            *p++ = static_cast<char>('0' + exponent / 100);
+        *p++ = static_cast<char>('0' + exponent / 10 % 10);
+        *p++ = static_cast<char>('0' + exponent % 10);
+    } else if (point <= 0) {
+        // 0.00ddd
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -point);
+        p += -point;
+        memcpy(p, digits, len);
+        p += len;
+    } else if (point < len) {
+        // dd.ddd
+        memcpy(p, digits, point);
+        p += point;
+        *p++ = '.';
+        memcpy(p, digits + point, len - point);
+        p += len - point;
+    } else {
+        // ddd00
+        memcpy(p, digits, len);
+        p += len;
+        memset(p, '0', point - len);
+        p += point - len;
+    }
+    out.append(buf, p - buf);
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Integer formatting
+ *
+ * Integers are written two digits at a time from a table of the pairs "00" to "99", from the
+ * least significant end of a stack buffer, and appended to the output in one call.
+ */
+
+static const char digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* write_digits(value, end)
+ *
+ * Write the decimal digits of value backwards from end, and return a pointer to the first one.
+ * There must be room for 20 chars before end, enough for any uint64_t.
+ */
+template <typename Unsigned>
+static char *write_digits(Unsigned value, char *end) {
+    char *p = end;
+    while (value >= 100) {
+        const size_t pair = static_cast<size_t>(value % 100) * 2;
+        value /= 100;
+        p -= 2;
+        memcpy(p, digit_pairs + pair, 2);
+    }
+    if (value >= 10) {
+        p -= 2;
+        memcpy(p, digit_pairs + static_cast<size_t>(value) * 2, 2);
+    } else {
+        *--p = static_cast<char>('0' + value);
     }
+    return p;
+}
+
+template <typename Integer>
+static bool is_negative(Integer value, std::true_type /* is_signed */) { return value < 0; }
+template <typename Integer>
+static bool is_negative(Integer, std::false_type /* is_signed */) { return false; }
+
+/* dump_integer(value, out)
+ *
+ * Append any integer type up to 64 bits, signed or unsigned, in the same form as printf.
+ */
+template <typename Integer>
+static void dump_integer(Integer value, string &out) {
+    typedef typename std::make_unsigned<Integer>::type Unsigned;
+    static_assert(sizeof(Unsigned) <= sizeof(uint64_t), "integer type too wide");
+    const bool negative = is_negative(value, std::is_signed<Integer>());
+    // Negate in the unsigned type so that the minimum value doesn't overflow.
+    Unsigned magnitude = static_cast<Unsigned>(value);
+    if (negative)
+        magnitude = static_cast<Unsigned>(0 - magnitude);
+
+    char buf[24];
+    char *end = buf + sizeof buf;
+    char *p = write_digits(magnitude, end);
+    if (negative)
+        *--p = '-';
+    out.append(p, end - p);
 }
 
 static void dump(int value, string &out) {
-    char buf[32];
-    snprintf(buf, sizeof buf, "%d", value);
-    out += buf;
+    dump_integer(value, out);
 }
 
 static void dump(bool value, string &out) {
     out += value ? "true" : "false";
 }
 
-static void dump(const string &value, string &out) {
+/* find_escape_special(s, i, size)
+ *
+ * Return the position of the first byte in s[i, size) that dump() may have to escape: '"',
+ * '\\', a control character, or 0xe2, which starts U+2028 and U+2029. Return size if there is
+ * none. Everything before it can be appended verbatim.
+ */
+static inline bool is_escape_special(char ch) {
+    return ch == '"' || ch == '\\' || static_cast<uint8_t>(ch) < 0x20
+        || static_cast<uint8_t>(ch) == 0xe2;
+}
+
+static inline size_t find_escape_special(const char *s, size_t i, size_t size) {
+#if JSON11_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i separator = _mm_set1_epi8(static_cast<char>(0xe2));
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; i + 16 <= size; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        const __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, separator),
+                         _mm_cmpeq_epi8(_mm_min_epu8(v, control), v)));
+        const int mask = _mm_movemask_epi8(special);
+        if (mask)
+            return i + trailing_zeroes(static_cast<uint64_t>(mask));
+    }
+#else
+    // Eight bytes at a time, as in find_string_special(). The exact position is found bytewise
+    // below.
+    const uint64_t ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t x;
+        memcpy(&x, s + i, sizeof x);
+        const uint64_t q = x ^ (ones * '"'), b = x ^ (ones * '\\'), e = x ^ (ones * 0xe2);
+        if ((((x - ones * 0x20) & ~x) | ((q - ones) & ~q) | ((b - ones) & ~b)
+             | ((e - ones) & ~e)) & highs)
+            break;
+    }
+#endif
+    while (i < size && !is_escape_special(s[i]))
+        i++;
+    return i;
+}
+
+static void dump(const char *s, size_t size, string &out) {
+    static const char hex_digits[] = "0123456789abcdef";
     out += '"';
-    for (size_t i = 0; i < value.length(); i++) {
-        const char ch = value[i];
+    size_t i = 0;
+    while (true) {
+        const size_t run_end = find_escape_special(s, i, size);
+        out.append(s + i, run_end - i);
+        if (run_end == size)
+            break;
+        i = run_end;
+        const char ch = s[i];
         if (ch == '\\') {
             out += "\\\\";
         } else if (ch == '"') {
@@ -93,20 +599,21 @@ static void dump(const string &value, string &out) {
         } else if (ch == '\t') {
             out += "\\t";
         } else if (static_cast<uint8_t>(ch) <= 0x1f) {
-            char buf[8];
-            snprintf(buf, sizeof buf, "\\u%04x", ch);
-            out += buf;
-        } else if (static_cast<uint8_t>(ch) == 0xe2 && static_cast<uint8_t>(value[i+1]) == 0x80
-                   && static_cast<uint8_t>(value[i+2]) == 0xa8) {
+            const char buf[6] = { '\\', 'u', '0', '0', hex_digits[ch >> 4], hex_digits[ch & 0xf] };
+            out.append(buf, sizeof buf);
+        } else if (i + 2 < size && static_cast<uint8_t>(s[i+1]) == 0x80
+                   && static_cast<uint8_t>(s[i+2]) == 0xa8) {
             out += "\\u2028";
             i += 2;
-        } else if (static_cast<uint8_t>(ch) == 0xe2 && static_cast<uint8_t>(value[i+1]) == 0x80
-                   && static_cast<uint8_t>(value[i+2]) == 0xa9) {
+        } else if (i + 2 < size && static_cast<uint8_t>(s[i+1]) == 0x80
+                   && static_cast<uint8_t>(s[i+2]) == 0xa9) {
             out += "\\u2029";
             i += 2;
         } else {
+            // Any other character starting with 0xe2.
             out += ch;
         }
+        i++;
     }
     out += '"';
 }
@@ -123,13 +630,13 @@ static void dump(const Json::array &values, string &out) {
     out += "]";
 }
 
-static void dump(const Json::object &values, string &out) {
+static void dump(const ObjectEntries &values, string &out) {
     bool first = true;
     out += "{";
     for (const auto &kv : values) {
         if (!first)
             out += ", ";
-        dump(kv.first, out);
+        dump(kv.first.data(), kv.first.size(), out);
         out += ": ";
         kv.second.dump(out);
         first = false;
@@ -137,98 +644,349 @@ static void dump(const Json::object &values, string &out) {
     out += "}";
 }
 
-void Json::dump(string &out) const {
-    m_ptr->dump(out);
-}
-
 /* * * * * * * * * * * * * * * * * * * *
  * Value wrappers
  */
 
-template <Json::Type tag, typename T>
+template <JsonValue::Kind node_kind, typename T>
 class Value : public JsonValue {
-protected:
-
+public:
     // Constructors
-    explicit Value(const T &value) : m_value(value) {}
-    explicit Value(T &&value)      : m_value(move(value)) {}
-
-    // Get type tag
-    Json::Type type() const override {
-        return tag;
-    }
+    explicit Value(const T &value) : JsonValue(node_kind), m_value(value) {}
+    explicit Value(T &&value)      : JsonValue(node_kind), m_value(move(value)) {}
 
     // Comparisons
-    bool equals(const JsonValue * other) const override {
-        return m_value == static_cast<const Value<tag, T> *>(other)->m_value;
-    }
-    bool less(const JsonValue * other) const override {
-        return m_value < static_cast<const Value<tag, T> *>(other)->m_value;
-    }
+    bool equals(const Value *other) const { return m_value == other->m_value; }
+    bool less(const Value *other) const { return m_value < other->m_value; }
 
-    const T m_value;
-    void dump(string &out) const override { json11::dump(m_value, out); }
-};
+    void dump(string &out) const { json11::dump(m_value, out); }
 
-class JsonDouble final : public Value<Json::NUMBER, double> {
-    double number_value() const override { return m_value; }
-    int int_value() const override { return static_cast<int>(m_value); }
-    bool equals(const JsonValue * other) const override { return m_value == other->number_value(); }
-    bool less(const JsonValue * other)   const override { return m_value <  other->number_value(); }
-public:
-    explicit JsonDouble(double value) : Value(value) {}
+protected:
+    T m_value;
 };
 
-class JsonInt final : public Value<Json::NUMBER, int> {
-    double number_value() const override { return m_value; }
-    int int_value() const override { return m_value; }
-    bool equals(const JsonValue * other) const override { return m_value == other->number_value(); }
-    bool less(const JsonValue * other)   const override { return m_value <  other->number_value(); }
-public:
-    explicit JsonInt(int value) : Value(value) {}
-};
+// Compare the characters of two strings the way std::string::compare does.
+static int compare_strings(Json::string_ref a, Json::string_ref b) {
+    const int result = memcmp(a.data, b.data, a.size < b.size ? a.size : b.size);
+    if (result != 0)
+        return result;
+    return (a.size < b.size) ? -1 : (a.size > b.size);
+}
 
-class JsonBoolean final : public Value<Json::BOOL, bool> {
-    bool bool_value() const override { return m_value; }
+class JsonString final : public Value<JsonValue::STRING, string> {
 public:
-    explicit JsonBoolean(bool value) : Value(value) {}
+    explicit JsonString(const string &value) : Value(value) {}
+    explicit JsonString(string &&value)      : Value(move(value)) {}
+
+    const string &string_value() const { return m_value; }
+    Json::string_ref string_ref_value() const {
+        return Json::string_ref { m_value.data(), m_value.size() };
+    }
 };
 
-class JsonString final : public Value<Json::STRING, string> {
-    const string &string_value() const override { return m_value; }
+/* JsonStringRef
+ *
+ * A string parsed with ParseOptions::zero_copy_strings: a view into the input buffer, which it
+ * keeps alive. The std::string that string_value() returns is only built the first time it is
+ * asked for, and then kept.
+ */
+class JsonStringRef final : public JsonValue {
 public:
-    explicit JsonString(const string &value) : Value(value) {}
-    explicit JsonString(string &&value)      : Value(move(value)) {}
+    JsonStringRef(const std::shared_ptr<const string> &buffer, const char *data, size_t size)
+        : JsonValue(STRING_REF), m_buffer(buffer), m_data(data), m_size(size),
+          m_string(nullptr) {}
+    ~JsonStringRef() { delete m_string.load(std::memory_order_relaxed); }
+
+    const string &string_value() const;
+    Json::string_ref string_ref_value() const {
+        return Json::string_ref { m_data, m_size };
+    }
+
+private:
+    const std::shared_ptr<const string> m_buffer;
+    const char * const m_data;
+    const size_t m_size;
+    mutable std::atomic<string *> m_string;
 };
 
-class JsonArray final : public Value<Json::ARRAY, Json::array> {
-    const Json::array &array_items() const override { return m_value; }
-    const Json & operator[](size_t i) const override;
+const string & JsonStringRef::string_value() const {
+    string *value = m_string.load(std::memory_order_acquire);
+    if (!value) {
+        string *built = new string(m_data, m_size);
+        // If another thread published its copy first, use that one instead.
+        if (m_string.compare_exchange_strong(value, built, std::memory_order_acq_rel)) {
+            value = built;
+        } else {
+            delete built;
+        }
+    }
+    return *value;
+}
+
+// The characters of a string node of either kind.
+static Json::string_ref string_ref_of(const JsonValue *node) {
+    return node->kind() == JsonValue::STRING_REF
+        ? static_cast<const JsonStringRef *>(node)->string_ref_value()
+        : static_cast<const JsonString *>(node)->string_ref_value();
+}
+
+class JsonArray final : public Value<JsonValue::ARRAY, Json::array> {
 public:
     explicit JsonArray(const Json::array &value) : Value(value) {}
     explicit JsonArray(Json::array &&value)      : Value(move(value)) {}
+
+    const Json::array &array_items() const { return m_value; }
+    const Json & operator[](size_t i) const;
+
+    // Pass each element to f, for JsonValue::destroy() to take apart.
+    template <typename F>
+    void release_elements(F &&f) {
+        for (Json &item : m_value)
+            f(item);
+    }
 };
 
-class JsonObject final : public Value<Json::OBJECT, Json::object> {
-    const Json::object &object_items() const override { return m_value; }
-    const Json & operator[](const string &key) const override;
+/* JsonNumberArray
+ *
+ * A parsed array of numbers (see ParseOptions::number_array_threshold), held as contiguous
+ * doubles, with a bit per element for those that were ints; every int is exact as a double.
+ * The Json::array that array_items() returns is only built the first time it is asked for,
+ * and then kept. operator[] does not build it: it returns elements from chunks of
+ * chunk_size Json, each built the first time one of its elements is asked for.
+ */
+class JsonNumberArray final : public JsonValue {
 public:
-    explicit JsonObject(const Json::object &value) : Value(value) {}
-    explicit JsonObject(Json::object &&value)      : Value(move(value)) {}
+    // ints is empty if none of values are ints.
+    JsonNumberArray(vector<double> &&values, vector<bool> &&ints)
+        : JsonValue(NUMBER_ARRAY), m_values(move(values)), m_ints(move(ints)), m_items(nullptr),
+          m_chunks(nullptr) {}
+    ~JsonNumberArray();
+
+    // Values compare as numbers, as the elements of a Json::array do.
+    bool equals(const JsonNumberArray *other) const { return m_values == other->m_values; }
+    bool less(const JsonNumberArray *other) const { return m_values < other->m_values; }
+    // Whether other holds the same numbers in the same representation, for ValueTable.
+    bool same(const JsonNumberArray *other) const {
+        return m_ints == other->m_ints && m_values.size() == other->m_values.size()
+            && (m_values.empty() || memcmp(m_values.data(), other->m_values.data(),
+                                           m_values.size() * sizeof(double)) == 0);
+    }
+    void dump(string &out) const {
+        out += "[";
+        for (size_t i = 0; i < m_values.size(); i++) {
+            if (i > 0)
+                out += ", ";
+            if (is_int(i))
+                json11::dump(static_cast<int>(m_values[i]), out);
+            else
+                json11::dump(m_values[i], out);
+        }
+        out += "]";
+    }
+
+    Json::number_span number_span_value() const {
+        return Json::number_span(m_values.data(), m_values.size());
+    }
+    bool is_int(size_t i) const { return !m_ints.empty() && m_ints[i]; }
+    size_t size() const { return m_values.size(); }
+    // Element i as a Json, by value.
+    Json element(size_t i) const {
+        return is_int(i) ? Json(static_cast<int>(m_values[i])) : Json(m_values[i]);
+    }
+    const Json::array &array_items() const;
+    const Json & operator[](size_t i) const;
+
+private:
+    static const size_t chunk_size = 64;
+    size_t chunk_count() const { return (m_values.size() + chunk_size - 1) / chunk_size; }
+
+    vector<double> m_values;
+    vector<bool> m_ints;
+    mutable std::atomic<Json::array *> m_items;
+    // chunk_count() pointers, each null until that chunk is built.
+    mutable std::atomic<std::atomic<Json *> *> m_chunks;
 };
 
-class JsonNull final : public Value<Json::NUL, NullStruct> {
+// Return the elements of either kind of array node, building them for a JsonNumberArray.
+static const Json::array &array_items_of(const JsonValue *node) {
+    return node->kind() == JsonValue::NUMBER_ARRAY
+        ? static_cast<const JsonNumberArray *>(node)->array_items()
+        : static_cast<const JsonArray *>(node)->array_items();
+}
+
+/* hash_key(s, len)
+ *
+ * 64-bit hash of a key, for object indexes: eight bytes at a time, each step mixed with a
+ * multiply and shift.
+ */
+static inline uint64_t hash_key(const char *s, size_t len) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+    for (; len >= 8; s += 8, len -= 8) {
+        uint64_t w;
+        memcpy(&w, s, sizeof w);
+        h = (h ^ w) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    uint64_t w = 0;
+    memcpy(&w, s, len);
+    h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 29);
+}
+
+/* JsonObject
+ *
+ * Objects are stored as a flat vector of entries sorted by key: lookups are binary searches
+ * over contiguous memory, and dump() walks it in order. An object made from a Json::object
+ * keeps that map to return from object_items(), and its long keys are views of the map's
+ * keys. A parsed object has no map until object_items() is first called; it is then built
+ * once and kept, as object_items() returns a reference.
+ *
+ * Long interned keys point into a KeyTable shared between objects, which each of them keeps
+ * alive.
+ *
+ * Wide objects can also carry a hash index: an open-addressing table (linear probing, at most
+ * half full) whose slots hold the upper 32 bits of a key's hash and its entry number plus one,
+ * or 0 if empty. Most mismatches are rejected on the hash bits without touching the key.
+ */
+class JsonObject final : public JsonValue {
 public:
-    JsonNull() : Value({}) {}
+    explicit JsonObject(const Json::object &values)
+        : JsonValue(OBJECT), m_items(new Json::object(values)), m_keys_in_items(true),
+          m_index_mask(0) {
+        entries_from_items();
+    }
+    explicit JsonObject(Json::object &&values)
+        : JsonValue(OBJECT), m_items(new Json::object(move(values))), m_keys_in_items(true),
+          m_index_mask(0) {
+        entries_from_items();
+    }
+    // entries must already be sorted by key, with no duplicates; see sort_entries(). Keys that
+    // are views point into storage that key_owner keeps alive. An index is built if there are
+    // at least index_threshold entries (and index_threshold isn't 0).
+    JsonObject(ObjectEntries &&entries, std::shared_ptr<const void> &&key_owner,
+               size_t index_threshold)
+        : JsonValue(OBJECT), m_entries(move(entries)), m_key_owner(move(key_owner)),
+          m_items(nullptr), m_keys_in_items(false), m_index_mask(0) {
+        if (index_threshold > 0 && m_entries.size() >= index_threshold)
+            build_index();
+    }
+    ~JsonObject() { delete m_items.load(std::memory_order_relaxed); }
+
+    bool equals(const JsonObject *other) const { return m_entries == other->m_entries; }
+    bool less(const JsonObject *other) const { return m_entries < other->m_entries; }
+    void dump(string &out) const { json11::dump(m_entries, out); }
+    const Json::object &object_items() const;
+
+    // Return the value for key, or nullptr if there is none.
+    const Json * find(Json::string_ref key) const;
+    const Json * find(const Json::Key &key) const;
+
+    const ObjectEntries &entries() const { return m_entries; }
+    const std::shared_ptr<const void> &key_owner() const { return m_key_owner; }
+    // Whether long keys are views of the map in object_items(), which only this object keeps.
+    bool keys_in_items() const { return m_keys_in_items; }
+    bool indexed() const { return m_index != nullptr; }
+
+    // Pass each value to f, for JsonValue::destroy() to take apart. This includes the copies
+    // in object_items(), if it was built.
+    template <typename F>
+    void release_elements(F &&f) {
+        for (auto &entry : m_entries)
+            f(entry.second);
+        if (Json::object *items = m_items.load(std::memory_order_relaxed)) {
+            for (auto &kv : *items)
+                f(kv.second);
+        }
+    }
+
+private:
+    // Fill the entries from the map the object was made from.
+    void entries_from_items() {
+        const Json::object &items = *m_items.load(std::memory_order_relaxed);
+        m_entries.reserve(items.size());
+        for (const auto &kv : items)
+            m_entries.emplace_back(ObjectKey::view(kv.first.data(), kv.first.size()), kv.second);
+    }
+    void build_index();
+    // Return the entry number of key, or m_entries.size() if it is absent. hash is key's
+    // hash_key(), and is only read if there is an index.
+    size_t position(Json::string_ref key, uint64_t hash) const;
+
+    ObjectEntries m_entries;
+    std::shared_ptr<const void> m_key_owner;
+    mutable std::atomic<Json::object *> m_items;
+    const bool m_keys_in_items;
+    std::unique_ptr<uint64_t[]> m_index;
+    size_t m_index_mask;
 };
 
+/* sort_entries(entries)
+ *
+ * Sort entries collected in document order by key. Where a key is repeated only the last value
+ * is kept, as if each entry had been assigned into a std::map.
+ */
+static void sort_entries(ObjectEntries &entries) {
+    // Most objects arrive already sorted, e.g. everything written by dump().
+    size_t i = 1;
+    while (i < entries.size() && entries[i - 1].first < entries[i].first)
+        i++;
+    if (i >= entries.size())
+        return;
+
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const ObjectEntries::value_type &a, const ObjectEntries::value_type &b) {
+                         return a.first < b.first;
+                     });
+    size_t out = 0;
+    for (i = 0; i < entries.size(); i++) {
+        if (out > 0 && entries[out - 1].first == entries[i].first) {
+            entries[out - 1].second = move(entries[i].second);
+        } else {
+            if (out != i)
+                entries[out] = move(entries[i]);
+            out++;
+        }
+    }
+    entries.erase(entries.begin() + out, entries.end());
+}
+
+// Json::dump() dispatches to the node classes, so it follows them.
+void Json::dump(string &out) const {
+    switch (m_tag) {
+    case NUL:
+        out += "null";
+        break;
+    case INT_NUMBER:
+        json11::dump(m_value.i, out);
+        break;
+    case NUMBER:
+        json11::dump(m_value.d, out);
+        break;
+    case BOOL:
+        json11::dump(m_value.b, out);
+        break;
+    case STRING: {
+        const string_ref text = string_ref_of(node());
+        json11::dump(text.data, text.size, out);
+        break;
+    }
+    case ARRAY:
+        if (node()->kind() == JsonValue::NUMBER_ARRAY)
+            static_cast<const JsonNumberArray *>(node())->dump(out);
+        else
+            static_cast<const JsonArray *>(node())->dump(out);
+        break;
+    case OBJECT:
+        static_cast<const JsonObject *>(node())->dump(out);
+        break;
+    }
+}
+
 /* * * * * * * * * * * * * * * * * * * *
  * Static globals - static-init-safe
  */
 struct Statics {
-    const std::shared_ptr<JsonValue> null = make_shared<JsonNull>();
-    const std::shared_ptr<JsonValue> t = make_shared<JsonBoolean>(true);
-    const std::shared_ptr<JsonValue> f = make_shared<JsonBoolean>(false);
+    const Json null;
     const string empty_string;
     const vector<Json> empty_vector;
     const map<string, Json> empty_map;
@@ -241,102 +999,1786 @@ static const Statics & statics() {
 }
 
 static const Json & static_null() {
-    // This has to be separate, not in Statics, because Json() accesses statics().null.
-    static const Json json_null;
-    return json_null;
+    return statics().null;
 }
 
 /* * * * * * * * * * * * * * * * * * * *
  * Constructors
  */
 
-Json::Json() noexcept                  : m_ptr(statics().null) {}
-Json::Json(std::nullptr_t) noexcept    : m_ptr(statics().null) {}
-Json::Json(double value)               : m_ptr(make_shared<JsonDouble>(value)) {}
-Json::Json(int value)                  : m_ptr(make_shared<JsonInt>(value)) {}
-Json::Json(bool value)                 : m_ptr(value ? statics().t : statics().f) {}
-Json::Json(const string &value)        : m_ptr(make_shared<JsonString>(value)) {}
-Json::Json(string &&value)             : m_ptr(make_shared<JsonString>(move(value))) {}
-Json::Json(const char * value)         : m_ptr(make_shared<JsonString>(value)) {}
-Json::Json(const Json::array &values)  : m_ptr(make_shared<JsonArray>(values)) {}
-Json::Json(Json::array &&values)       : m_ptr(make_shared<JsonArray>(move(values))) {}
-Json::Json(const Json::object &values) : m_ptr(make_shared<JsonObject>(values)) {}
-Json::Json(Json::object &&values)      : m_ptr(make_shared<JsonObject>(move(values))) {}
-
-/* * * * * * * * * * * * * * * * * * * *
- * Accessors
- */
-
-Json::Type Json::type()                           const { return m_ptr->type();         }
-double Json::number_value()                       const { return m_ptr->number_value(); }
-int Json::int_value()                             const { return m_ptr->int_value();    }
-bool Json::bool_value()                           const { return m_ptr->bool_value();   }
-const string & Json::string_value()               const { return m_ptr->string_value(); }
-const vector<Json> & Json::array_items()          const { return m_ptr->array_items();  }
-const map<string, Json> & Json::object_items()    const { return m_ptr->object_items(); }
-const Json & Json::operator[] (size_t i)          const { return (*m_ptr)[i];           }
-const Json & Json::operator[] (const string &key) const { return (*m_ptr)[key];         }
-
-double                    JsonValue::number_value()              const { return 0; }
-int                       JsonValue::int_value()                 const { return 0; }
-bool                      JsonValue::bool_value()                const { return false; }
-const string &            JsonValue::string_value()              const { return statics().empty_string; }
-const vector<Json> &      JsonValue::array_items()               const { return statics().empty_vector; }
-const map<string, Json> & JsonValue::object_items()              const { return statics().empty_map; }
-const Json &              JsonValue::operator[] (size_t)         const { return static_null(); }
-const Json &              JsonValue::operator[] (const string &) const { return static_null(); }
-
-const Json & JsonObject::operator[] (const string &key) const {
-    auto iter = m_value.find(key);
-    return (iter == m_value.end()) ? static_null() : iter->second;
+Json::Json() noexcept                  : m_tag(NUL),        m_value() {}
+Json::Json(std::nullptr_t) noexcept    : m_tag(NUL),        m_value() {}
+Json::Json(double value) noexcept      : m_tag(NUMBER),     m_value() { m_value.d = value; }
+Json::Json(int value) noexcept         : m_tag(INT_NUMBER), m_value() { m_value.i = value; }
+Json::Json(bool value) noexcept        : m_tag(BOOL),       m_value() { m_value.b = value; }
+Json::Json(const string &value)        : m_tag(STRING),     m_value() {
+    m_value.node = new JsonString(value);
 }
-const Json & JsonArray::operator[] (size_t i) const {
-    if (i >= m_value.size()) return static_null();
-    else return m_value[i];
+Json::Json(string &&value)             : m_tag(STRING),     m_value() {
+    m_value.node = new JsonString(move(value));
+}
+Json::Json(const char * value)         : m_tag(STRING),     m_value() {
+    m_value.node = new JsonString(value);
+}
+Json::Json(const Json::array &values)  : m_tag(ARRAY),      m_value() {
+    m_value.node = new JsonArray(values);
+}
+Json::Json(Json::array &&values)       : m_tag(ARRAY),      m_value() {
+    m_value.node = new JsonArray(move(values));
+}
+Json::Json(const Json::object &values) : m_tag(OBJECT),     m_value() {
+    m_value.node = new JsonObject(values);
+}
+Json::Json(Json::object &&values)      : m_tag(OBJECT),     m_value() {
+    m_value.node = new JsonObject(move(values));
+}
+Json::Json(Type type, JsonValue *node) noexcept : m_tag(type), m_value() {
+    m_value.node = node;
 }
 
-/* * * * * * * * * * * * * * * * * * * *
- * Comparison
- */
-
-bool Json::operator== (const Json &other) const {
-    if (m_ptr == other.m_ptr)
-        return true;
-    if (m_ptr->type() != other.m_ptr->type())
-        return false;
+// Drop the reference an arena node holds on its arena (see JsonArena::create()).
+static void release_arena_of(JsonValue *node);
 
-    return m_ptr->equals(other.m_ptr.get());
+// Destroy node as a T, and free it unless its memory belongs to an arena.
+template <typename T>
+static void destroy_as(JsonValue *node, bool in_arena) {
+    T *value = static_cast<T *>(node);
+    if (in_arena) {
+        value->~T();
+        release_arena_of(node);
+    } else {
+        delete value;
+    }
 }
 
-bool Json::operator< (const Json &other) const {
-    if (m_ptr == other.m_ptr)
-        return false;
-    if (m_ptr->type() != other.m_ptr->type())
-        return m_ptr->type() < other.m_ptr->type();
+/* JsonValue::destroy(node)
+ *
+ * Strings and arrays of numbers are freed at once. An array or object first has its elements'
+ * references released; those that were the last references to such leaves are freed on the
+ * spot, and arrays and objects are kept on a work list to be taken apart the same way, so
+ * that freeing never recurses and is bounded in stack by neither depth nor width. The node
+ * itself is then freed with nothing left for its destructor to release.
+ */
+void JsonValue::destroy(JsonValue *node) {
+    vector<JsonValue *> pending;
+    auto release = [&pending](Json &value) {
+        if (!value.has_node())
+            return;
+        JsonValue *child = value.node();
+        value.m_tag = Json::NUL;
+        if (!child->release())
+            return;
+        switch (child->m_kind) {
+        case STRING:
+            return destroy_as<JsonString>(child, child->m_in_arena);
+        case STRING_REF:
+            return destroy_as<JsonStringRef>(child, child->m_in_arena);
+        case NUMBER_ARRAY:
+            return destroy_as<JsonNumberArray>(child, child->m_in_arena);
+        case ARRAY:
+        case OBJECT:
+            return pending.push_back(child);
+        }
+    };
 
-    return m_ptr->less(other.m_ptr.get());
+    for (;;) {
+        switch (node->m_kind) {
+        case STRING:
+            destroy_as<JsonString>(node, node->m_in_arena);
+            break;
+        case STRING_REF:
+            destroy_as<JsonStringRef>(node, node->m_in_arena);
+            break;
+        case ARRAY:
+            static_cast<JsonArray *>(node)->release_elements(release);
+            destroy_as<JsonArray>(node, node->m_in_arena);
+            break;
+        case NUMBER_ARRAY:
+            destroy_as<JsonNumberArray>(node, node->m_in_arena);
+            break;
+        case OBJECT:
+            static_cast<JsonObject *>(node)->release_elements(release);
+            destroy_as<JsonObject>(node, node->m_in_arena);
+            break;
+        }
+        if (pending.empty())
+            return;
+        node = pending.back();
+        pending.pop_back();
+    }
 }
 
 /* * * * * * * * * * * * * * * * * * * *
- * Parsing
+ * Accessors
  */
 
-/* esc(c)
- *
- * Format char c suitable for printing in an error message.
- */
-static inline string esc(char c) {
-    char buf[12];
-    if (static_cast<uint8_t>(c) >= 0x20 && static_cast<uint8_t>(c) <= 0x7f) {
-        snprintf(buf, sizeof buf, "'%c' (%d)", c, c);
-    } else {
-        snprintf(buf, sizeof buf, "(%d)", c);
+// Null, booleans and numbers are answered inline (see json11.hpp). Strings, arrays and objects
+// answer through m_value.node, whose class m_tag tells.
+const string & Json::string_value() const {
+    if (m_tag != STRING)
+        return statics().empty_string;
+    if (node()->kind() == JsonValue::STRING_REF)
+        return static_cast<const JsonStringRef *>(node())->string_value();
+    return static_cast<const JsonString *>(node())->string_value();
+}
+Json::string_ref Json::string_ref_value() const {
+    return m_tag == STRING ? string_ref_of(node()) : string_ref();
+}
+const vector<Json> & Json::array_items() const {
+    if (m_tag != ARRAY)
+        return statics().empty_vector;
+    return array_items_of(node());
+}
+const map<string, Json> & Json::object_items() const {
+    if (m_tag != OBJECT)
+        return statics().empty_map;
+    return static_cast<const JsonObject *>(node())->object_items();
+}
+Json::object_ref Json::object_ref_value() const {
+    object_ref members;
+    if (m_tag != OBJECT)
+        return members;
+    const ObjectEntries &entries = static_cast<const JsonObject *>(node())->entries();
+    if (entries.empty())
+        return members;
+    members.m_entries = entries.data();
+    members.m_values = reinterpret_cast<const char *>(&entries[0].second);
+    members.m_size = entries.size();
+    members.m_stride = sizeof(ObjectEntries::value_type);
+    return members;
+}
+Json::number_span Json::number_span_value() const {
+    if (m_tag != ARRAY || node()->kind() != JsonValue::NUMBER_ARRAY)
+        return number_span();
+    return static_cast<const JsonNumberArray *>(node())->number_span_value();
+}
+Json::string_ref Json::object_ref::key(size_t i) const {
+    return static_cast<const ObjectEntries::value_type *>(m_entries)[i].first;
+}
+const Json & Json::operator[] (size_t i) const {
+    if (m_tag != ARRAY)
+        return static_null();
+    if (node()->kind() == JsonValue::NUMBER_ARRAY)
+        return (*static_cast<const JsonNumberArray *>(node()))[i];
+    return (*static_cast<const JsonArray *>(node()))[i];
+}
+const Json & Json::operator[] (string_ref key) const {
+    if (m_tag != OBJECT)
+        return static_null();
+    const Json *value = static_cast<const JsonObject *>(node())->find(key);
+    return value ? *value : static_null();
+}
+const Json & Json::operator[] (const Key &key) const {
+    if (m_tag != OBJECT)
+        return static_null();
+    const Json *value = static_cast<const JsonObject *>(node())->find(key);
+    return value ? *value : static_null();
+}
+
+void JsonObject::build_index() {
+    if (m_entries.size() >= std::numeric_limits<uint32_t>::max())
+        return;
+    size_t slots = 16;
+    while (slots < 2 * m_entries.size())
+        slots *= 2;
+    m_index.reset(new uint64_t[slots]());
+    m_index_mask = slots - 1;
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        const uint64_t h = hash_key(m_entries[i].first.data(), m_entries[i].first.size());
+        size_t slot = h & m_index_mask;
+        while (m_index[slot])
+            slot = (slot + 1) & m_index_mask;
+        m_index[slot] = (h & 0xffffffff00000000ULL) | (i + 1);
     }
-    return string(buf);
 }
 
-static inline bool in_range(long x, long lower, long upper) {
-    return (x >= lower && x <= upper);
+static inline bool same_key(Json::string_ref a, Json::string_ref b) {
+    return a.size == b.size && memcmp(a.data, b.data, b.size) == 0;
+}
+
+size_t JsonObject::position(Json::string_ref key, uint64_t hash) const {
+    if (m_index) {
+        for (size_t slot = hash & m_index_mask; m_index[slot]; slot = (slot + 1) & m_index_mask) {
+            const uint64_t tagged = m_index[slot];
+            if ((tagged ^ hash) >> 32)
+                continue;
+            const size_t i = static_cast<uint32_t>(tagged) - 1;
+            if (same_key(m_entries[i].first, key))
+                return i;
+        }
+        return m_entries.size();
+    }
+
+    // Small objects are scanned linearly, since most keys are told apart by their length
+    // alone; larger ones are binary searched.
+    if (m_entries.size() <= 8) {
+        for (size_t i = 0; i < m_entries.size(); i++) {
+            if (same_key(m_entries[i].first, key))
+                return i;
+        }
+        return m_entries.size();
+    }
+    auto iter = std::lower_bound(m_entries.begin(), m_entries.end(), key,
+                                 [](const ObjectEntries::value_type &entry, Json::string_ref k) {
+                                     return compare_strings(entry.first, k) < 0;
+                                 });
+    return (iter != m_entries.end() && compare_strings(iter->first, key) == 0)
+        ? iter - m_entries.begin() : m_entries.size();
+}
+
+const Json * JsonObject::find(Json::string_ref key) const {
+    const size_t i = position(key, m_index ? hash_key(key.data, key.size) : 0);
+    return i < m_entries.size() ? &m_entries[i].second : nullptr;
+}
+
+const Json * JsonObject::find(const Json::Key &key) const {
+    // The hint is only ever a guess, so relaxed loads and stores are enough: a stale or torn
+    // one costs a compare, never a wrong answer.
+    const size_t hint = key.m_hint.load(std::memory_order_relaxed);
+    if (hint < m_entries.size() && same_key(m_entries[hint].first, key.m_name))
+        return &m_entries[hint].second;
+
+    const size_t i = position(key.m_name, key.m_hash);
+    if (i == m_entries.size())
+        return nullptr;
+    if (i <= std::numeric_limits<uint32_t>::max())
+        key.m_hint.store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+    return &m_entries[i].second;
+}
+
+Json::Key::Key(string name)
+    : m_name(move(name)), m_hash(hash_key(m_name.data(), m_name.size())), m_hint(0) {}
+
+Json::Key::Key(const Key &other)
+    : m_name(other.m_name), m_hash(other.m_hash),
+      m_hint(other.m_hint.load(std::memory_order_relaxed)) {}
+
+const Json::object & JsonObject::object_items() const {
+    Json::object *items = m_items.load(std::memory_order_acquire);
+    if (!items) {
+        // The entries are sorted, so every insertion goes at the end.
+        Json::object *built = new Json::object;
+        for (const auto &entry : m_entries)
+            built->emplace_hint(built->end(), string(entry.first.data(), entry.first.size()),
+                                entry.second);
+        // If another thread published its map first, use that one instead.
+        if (m_items.compare_exchange_strong(items, built, std::memory_order_acq_rel)) {
+            items = built;
+        } else {
+            delete built;
+        }
+    }
+    return *items;
+}
+const Json & JsonArray::operator[] (size_t i) const {
+    if (i >= m_value.size()) return static_null();
+    else return m_value[i];
+}
+
+const Json::array & JsonNumberArray::array_items() const {
+    Json::array *items = m_items.load(std::memory_order_acquire);
+    if (!items) {
+        Json::array *built = new Json::array;
+        built->reserve(m_values.size());
+        for (size_t i = 0; i < m_values.size(); i++) {
+            if (is_int(i))
+                built->emplace_back(static_cast<int>(m_values[i]));
+            else
+                built->emplace_back(m_values[i]);
+        }
+        // If another thread published its array first, use that one instead.
+        if (m_items.compare_exchange_strong(items, built, std::memory_order_acq_rel)) {
+            items = built;
+        } else {
+            delete built;
+        }
+    }
+    return *items;
+}
+
+const Json & JsonNumberArray::operator[] (size_t i) const {
+    if (i >= m_values.size())
+        return static_null();
+    // Once array_items() has been built, answer from it.
+    if (const Json::array *items = m_items.load(std::memory_order_acquire))
+        return (*items)[i];
+
+    std::atomic<Json *> *chunks = m_chunks.load(std::memory_order_acquire);
+    if (!chunks) {
+        std::atomic<Json *> *built = new std::atomic<Json *>[chunk_count()];
+        for (size_t c = 0; c < chunk_count(); c++)
+            built[c].store(nullptr, std::memory_order_relaxed);
+        if (m_chunks.compare_exchange_strong(chunks, built, std::memory_order_acq_rel)) {
+            chunks = built;
+        } else {
+            delete[] built;
+        }
+    }
+
+    const size_t c = i / chunk_size;
+    Json *chunk = chunks[c].load(std::memory_order_acquire);
+    if (!chunk) {
+        const size_t first = c * chunk_size;
+        const size_t left = m_values.size() - first;
+        const size_t count = left < chunk_size ? left : chunk_size;
+        Json *built = new Json[count];
+        for (size_t j = 0; j < count; j++)
+            built[j] = element(first + j);
+        // If another thread published this chunk first, use that one instead.
+        if (chunks[c].compare_exchange_strong(chunk, built, std::memory_order_acq_rel)) {
+            chunk = built;
+        } else {
+            delete[] built;
+        }
+    }
+    return chunk[i % chunk_size];
+}
+
+JsonNumberArray::~JsonNumberArray() {
+    delete m_items.load(std::memory_order_relaxed);
+    if (std::atomic<Json *> *chunks = m_chunks.load(std::memory_order_relaxed)) {
+        for (size_t c = 0; c < chunk_count(); c++)
+            delete[] chunks[c].load(std::memory_order_relaxed);
+        delete[] chunks;
+    }
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Comparison
+ */
+
+// Element i of an array node of either kind, by value, so that comparing a JsonNumberArray with
+// a JsonArray does not build its array_items().
+static Json element_of(const JsonValue *node, size_t i) {
+    return node->kind() == JsonValue::NUMBER_ARRAY
+        ? static_cast<const JsonNumberArray *>(node)->element(i)
+        : static_cast<const JsonArray *>(node)->array_items()[i];
+}
+static size_t array_size_of(const JsonValue *node) {
+    return node->kind() == JsonValue::NUMBER_ARRAY
+        ? static_cast<const JsonNumberArray *>(node)->size()
+        : static_cast<const JsonArray *>(node)->array_items().size();
+}
+
+// Compare two array nodes of either kind. Two JsonNumberArrays compare their doubles directly;
+// a JsonNumberArray and a JsonArray compare elements.
+static bool arrays_equal(const JsonValue *a, const JsonValue *b) {
+    if (a->kind() == JsonValue::ARRAY && b->kind() == JsonValue::ARRAY)
+        return static_cast<const JsonArray *>(a)->equals(static_cast<const JsonArray *>(b));
+    if (a->kind() == JsonValue::NUMBER_ARRAY && b->kind() == JsonValue::NUMBER_ARRAY)
+        return static_cast<const JsonNumberArray *>(a)->equals(
+            static_cast<const JsonNumberArray *>(b));
+    const size_t size = array_size_of(a);
+    if (size != array_size_of(b))
+        return false;
+    for (size_t i = 0; i < size; i++) {
+        if (element_of(a, i) != element_of(b, i))
+            return false;
+    }
+    return true;
+}
+
+static bool array_less(const JsonValue *a, const JsonValue *b) {
+    if (a->kind() == JsonValue::ARRAY && b->kind() == JsonValue::ARRAY)
+        return static_cast<const JsonArray *>(a)->less(static_cast<const JsonArray *>(b));
+    if (a->kind() == JsonValue::NUMBER_ARRAY && b->kind() == JsonValue::NUMBER_ARRAY)
+        return static_cast<const JsonNumberArray *>(a)->less(
+            static_cast<const JsonNumberArray *>(b));
+    const size_t size_a = array_size_of(a), size_b = array_size_of(b);
+    for (size_t i = 0; i < size_a && i < size_b; i++) {
+        const Json x = element_of(a, i), y = element_of(b, i);
+        if (x < y)
+            return true;
+        if (y < x)
+            return false;
+    }
+    return size_a < size_b;
+}
+
+bool Json::operator== (const Json &other) const {
+    if (type() != other.type())
+        return false;
+
+    switch (type()) {
+    case NUL:
+        return true;
+    case NUMBER:
+        return number_value() == other.number_value();
+    case BOOL:
+        return m_value.b == other.m_value.b;
+    case STRING:
+        // Either string may be a JsonStringRef.
+        return node() == other.node()
+            || compare_strings(string_ref_of(node()), string_ref_of(other.node())) == 0;
+    case ARRAY:
+        return node() == other.node() || arrays_equal(node(), other.node());
+    case OBJECT:
+        return node() == other.node() || static_cast<const JsonObject *>(node())->equals(
+            static_cast<const JsonObject *>(other.node()));
+    }
+    return false;
+}
+
+bool Json::operator< (const Json &other) const {
+    if (type() != other.type())
+        return type() < other.type();
+
+    switch (type()) {
+    case NUL:
+        return false;
+    case NUMBER:
+        return number_value() < other.number_value();
+    case BOOL:
+        return m_value.b < other.m_value.b;
+    case STRING:
+        return node() != other.node()
+            && compare_strings(string_ref_of(node()), string_ref_of(other.node())) < 0;
+    case ARRAY:
+        return node() != other.node() && array_less(node(), other.node());
+    case OBJECT:
+        return node() != other.node() && static_cast<const JsonObject *>(node())->less(
+            static_cast<const JsonObject *>(other.node()));
+    }
+    return false;
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Arena allocation
+ */
+
+/* JsonArena
+ *
+ * Bump allocator behind Json::Document. Allocations are carved out of blocks that double in
+ * size (up to max_block_size, or larger for a single big allocation); nothing is freed until
+ * the arena is reset or destroyed.
+ *
+ * The arena is shared by the Document that created it and by every node allocated in it, which
+ * may be kept after the Document has gone or moved on to another parse. m_live counts them,
+ * and the arena deletes itself when the last one releases it.
+ */
+class JsonArena final {
+public:
+    JsonArena() : m_pos(nullptr), m_end(nullptr), m_live(1) {}
+
+    // Drop a reference to the arena, deleting it if that was the last one.
+    void release() {
+        if (m_live.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+
+    // Whether any node allocated in the arena is still alive, so it can't be reset.
+    bool in_use() const { return m_live.load(std::memory_order_acquire) > 1; }
+
+    void *allocate(size_t size, size_t align) {
+        char *p = align_up(m_pos, align);
+        if (!m_pos || size > static_cast<size_t>(m_end - p)) {
+            add_block(size + align);
+            p = align_up(m_pos, align);
+        }
+        m_pos = p + size;
+        return p;
+    }
+
+    // Drop every allocation, keeping the largest block for the next parse.
+    void reset() {
+        if (m_blocks.empty())
+            return;
+        size_t largest = 0;
+        for (size_t i = 1; i < m_blocks.size(); i++) {
+            if (m_blocks[i].size > m_blocks[largest].size)
+                largest = i;
+        }
+        std::swap(m_blocks[0], m_blocks[largest]);
+        m_blocks.resize(1);
+        m_pos = m_blocks[0].data.get();
+        m_end = m_pos + m_blocks[0].size;
+    }
+
+    // Wrap a string or array in a Json whose node is allocated in this arena.
+    Json make(string &&value);
+    Json make(Json::array &&values);
+
+    // Wrap the values of items, which must all be numbers, in a JsonNumberArray, in arena if it
+    // is not null.
+    static Json make_number_array(const Json::array &items, JsonArena *arena);
+
+    // Wrap a view of size chars at data, which must point into buffer, in a string Json, in
+    // arena if it is not null.
+    static Json make_string_ref(const std::shared_ptr<const string> &buffer, const char *data,
+                                size_t size, JsonArena *arena);
+
+    // Wrap sorted entries (see sort_entries()) in an object Json, in arena if it is not null.
+    // key_owner keeps alive any storage that keys are views of.
+    static Json make_object(ObjectEntries &&entries, std::shared_ptr<const void> &&key_owner,
+                            size_t index_threshold, JsonArena *arena);
+
+private:
+    // Construct a node in the arena.
+    template <typename T, typename... Args>
+    JsonValue *create(Args &&... args);
+
+    static const size_t first_block_size = 4096;
+    static const size_t max_block_size = 1 << 20;
+
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    static char *align_up(char *p, size_t align) {
+        const uintptr_t bits = reinterpret_cast<uintptr_t>(p);
+        return p + ((align - bits % align) % align);
+    }
+
+    void add_block(size_t min_size) {
+        size_t size = m_blocks.empty() ? first_block_size : m_blocks.back().size * 2;
+        if (size > max_block_size)
+            size = max_block_size;
+        if (size < min_size)
+            size = min_size;
+        m_blocks.push_back(Block { std::unique_ptr<char[]>(new char[size]), size });
+        m_pos = m_blocks.back().data.get();
+        m_end = m_pos + size;
+    }
+
+    vector<Block> m_blocks;
+    char *m_pos;
+    char *m_end;
+    std::atomic<size_t> m_live;
+};
+
+/* create<T>(args...)
+ *
+ * Each node is preceded by a pointer to its arena, which it holds a reference to until it is
+ * destroyed. Nodes are only created by a parse, and a Document only parses into an arena that
+ * no node refers to (or a new one), so nothing can release the arena concurrently and the
+ * count can be bumped without a locked instruction.
+ */
+template <typename T, typename... Args>
+JsonValue *JsonArena::create(Args &&... args) {
+    const size_t align = alignof(T) > alignof(JsonArena *) ? alignof(T) : alignof(JsonArena *);
+    const size_t header = (sizeof(JsonArena *) + align - 1) / align * align;
+    char *p = static_cast<char *>(allocate(header + sizeof(T), align)) + header;
+    new (p - sizeof(JsonArena *)) JsonArena *(this);
+    m_live.store(m_live.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    T *node = new (p) T(std::forward<Args>(args)...);
+    node->m_in_arena = true;
+    return node;
+}
+
+static void release_arena_of(JsonValue *node) {
+    JsonArena *const *arena = reinterpret_cast<JsonArena *const *>(
+        reinterpret_cast<char *>(node) - sizeof(JsonArena *));
+    (*arena)->release();
+}
+
+Json JsonArena::make(string &&value) {
+    return Json(Json::STRING, create<JsonString>(move(value)));
+}
+
+Json JsonArena::make(Json::array &&values) {
+    return Json(Json::ARRAY, create<JsonArray>(move(values)));
+}
+
+Json JsonArena::make_number_array(const Json::array &items, JsonArena *arena) {
+    vector<double> values(items.size());
+    vector<bool> ints;
+    for (size_t i = 0; i < items.size(); i++) {
+        const Json &item = items[i];
+        if (item.m_tag == Json::INT_NUMBER) {
+            if (ints.empty())
+                ints.resize(items.size());
+            ints[i] = true;
+            values[i] = item.m_value.i;
+        } else {
+            values[i] = item.m_value.d;
+        }
+    }
+    if (!arena)
+        return Json(Json::ARRAY, new JsonNumberArray(move(values), move(ints)));
+    return Json(Json::ARRAY, arena->create<JsonNumberArray>(move(values), move(ints)));
+}
+
+Json JsonArena::make_string_ref(const std::shared_ptr<const string> &buffer, const char *data,
+                                size_t size, JsonArena *arena) {
+    if (!arena)
+        return Json(Json::STRING, new JsonStringRef(buffer, data, size));
+    return Json(Json::STRING, arena->create<JsonStringRef>(buffer, data, size));
+}
+
+Json JsonArena::make_object(ObjectEntries &&entries, std::shared_ptr<const void> &&key_owner,
+                            size_t index_threshold, JsonArena *arena) {
+    if (!arena)
+        return Json(Json::OBJECT, new JsonObject(move(entries), move(key_owner), index_threshold));
+    return Json(Json::OBJECT, arena->create<JsonObject>(move(entries), move(key_owner),
+                                                        index_threshold));
+}
+
+/* KeyTable
+ *
+ * The distinct long object keys (see ObjectKey) seen by a parse with ParseOptions::intern_keys.
+ * Each is copied once and found again by hash (the same open addressing as JsonObject's index),
+ * so the objects of a parse share their keys. Every object holds a reference to the table.
+ *
+ * Records tend to list the same keys in the same order, so the table also remembers which key
+ * followed each one last time, and tries that before hashing.
+ */
+class KeyTable final {
+public:
+    KeyTable() : m_next(1, 0), m_mask(15), m_slots(new uint64_t[16]()) {}
+
+    // Return the stored copy of the size chars at data, adding it if it is new. previous is
+    // the number of the key before it in the same object, or 0 for the first key; it is
+    // updated to this key's number.
+    Json::string_ref intern(const char *data, size_t size, uint32_t &previous) {
+        const Json::string_ref text(data, size);
+        const uint32_t predicted = m_next[previous];
+        if (predicted && same_key(m_keys[predicted - 1], text)) {
+            previous = predicted;
+            return m_keys[predicted - 1];
+        }
+
+        const uint64_t h = hash_key(data, size);
+        size_t slot = h & m_mask;
+        for (; m_slots[slot]; slot = (slot + 1) & m_mask) {
+            const uint64_t tagged = m_slots[slot];
+            const uint32_t number = static_cast<uint32_t>(tagged);
+            if (((tagged ^ h) >> 32) == 0 && same_key(m_keys[number - 1], text))
+                return follow(previous, number);
+        }
+        if (m_keys.size() >= std::numeric_limits<uint32_t>::max() - 1)
+            return Json::string_ref(copy(data, size), size);
+
+        m_keys.emplace_back(copy(data, size), size);
+        m_next.push_back(0);
+        const uint32_t number = static_cast<uint32_t>(m_keys.size());
+        m_slots[slot] = (h & 0xffffffff00000000ULL) | number;
+        if (2 * m_keys.size() > m_mask)
+            grow();
+        return follow(previous, number);
+    }
+
+private:
+    Json::string_ref follow(uint32_t &previous, uint32_t number) {
+        m_next[previous] = number;
+        previous = number;
+        return m_keys[number - 1];
+    }
+
+    const char *copy(const char *data, size_t size) {
+        m_text.emplace_back(new char[size]);
+        memcpy(m_text.back().get(), data, size);
+        return m_text.back().get();
+    }
+
+    void grow() {
+        m_mask = 2 * m_mask + 1;
+        m_slots.reset(new uint64_t[m_mask + 1]());
+        for (size_t i = 0; i < m_keys.size(); i++) {
+            const uint64_t h = hash_key(m_keys[i].data, m_keys[i].size);
+            size_t slot = h & m_mask;
+            while (m_slots[slot])
+                slot = (slot + 1) & m_mask;
+            m_slots[slot] = (h & 0xffffffff00000000ULL) | (i + 1);
+        }
+    }
+
+    vector<std::unique_ptr<char[]>> m_text;
+    vector<Json::string_ref> m_keys;  // key number n is m_keys[n - 1]
+    vector<uint32_t> m_next;          // the key that last followed key n (0: an object's start)
+    size_t m_mask;
+    std::unique_ptr<uint64_t[]> m_slots;
+};
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Deduplication
+ */
+
+/* ValueTable
+ *
+ * Hash-consing, for Json::dedupe() and ParseOptions::dedupe_values: each string, array and
+ * object is looked up among those seen before, and replaced by the equal one if there is one.
+ * Values are compared shallowly, by the identity of their children's nodes, so children must
+ * go through the table before their parent. The table holds a reference to every distinct value.
+ */
+class ValueTable final {
+public:
+    ValueTable() : m_mask(15), m_slots(new uint64_t[16]()) {}
+
+    // Return the first value seen that is equal to value, or value itself (recording it) if it
+    // is new. Null, booleans and numbers are returned as they are.
+    Json canonical(Json &&value) {
+        if (!value.has_node())
+            return move(value);
+        const uint64_t h = hash(value);
+        size_t slot = h & m_mask;
+        for (; m_slots[slot]; slot = (slot + 1) & m_mask) {
+            const uint64_t tagged = m_slots[slot];
+            const Json &seen = m_values[static_cast<uint32_t>(tagged) - 1];
+            if (((tagged ^ h) >> 32) == 0 && same(seen, value))
+                return seen;
+        }
+        if (m_values.size() >= std::numeric_limits<uint32_t>::max() - 1)
+            return move(value);
+
+        m_values.push_back(move(value));
+        m_hashes.push_back(h);
+        m_slots[slot] = (h & 0xffffffff00000000ULL) | m_values.size();
+        if (2 * m_values.size() > m_mask)
+            grow();
+        return m_values.back();
+    }
+
+    // Return value with every string, array and object in it replaced by its canonical one.
+    // Nodes whose children are all unchanged are reused rather than rebuilt.
+    Json dedupe(const Json &value) {
+        if (value.m_tag == Json::ARRAY && value.node()->kind() != JsonValue::NUMBER_ARRAY) {
+            const Json::array &items = value.array_items();
+            Json::array deduped;
+            if (!dedupe_children(items.begin(), items.end(), deduped, [](const Json &item) {
+                    return &item;
+                }))
+                return canonical(Json(value));
+            return canonical(Json(move(deduped)));
+        }
+        if (value.m_tag == Json::OBJECT) {
+            const JsonObject *object = static_cast<const JsonObject *>(value.node());
+            const ObjectEntries &entries = object->entries();
+            Json::array values;
+            if (!dedupe_children(entries.begin(), entries.end(), values,
+                                 [](const ObjectEntries::value_type &entry) {
+                                     return &entry.second;
+                                 }))
+                return canonical(Json(value));
+            ObjectEntries rebuilt;
+            rebuilt.reserve(entries.size());
+            for (size_t i = 0; i < entries.size(); i++) {
+                // Keys that view the object's own map must be copied: the map goes with it.
+                const ObjectKey &key = entries[i].first;
+                rebuilt.emplace_back(object->keys_in_items() ? ObjectKey(key.data(), key.size())
+                                                             : key,
+                                     move(values[i]));
+            }
+            return canonical(JsonArena::make_object(
+                move(rebuilt), std::shared_ptr<const void>(object->key_owner()),
+                object->indexed() ? 1 : 0, nullptr));
+        }
+        return canonical(Json(value));
+    }
+
+private:
+    // Deduplicate the child of each element in [begin, end) into out. Return false, leaving
+    // out unspecified, if none of them changed.
+    template <typename Iter, typename Child>
+    bool dedupe_children(Iter begin, Iter end, Json::array &out, Child child) {
+        bool changed = false;
+        out.reserve(end - begin);
+        for (Iter it = begin; it != end; ++it) {
+            out.push_back(dedupe(*child(*it)));
+            changed |= !identical(out.back(), *child(*it));
+        }
+        return changed;
+    }
+
+    // Whether a and b are the same node, or equal scalars of the same representation.
+    static bool identical(const Json &a, const Json &b) {
+        if (a.m_tag != b.m_tag)
+            return false;
+        return a.has_node() ? a.node() == b.node() : scalar_bits(a) == scalar_bits(b);
+    }
+
+    // The payload of value, a node's address or a scalar's bits.
+    static uint64_t scalar_bits(const Json &value) {
+        uint64_t bits = 0;
+        if (value.has_node())
+            bits = reinterpret_cast<uintptr_t>(value.node());
+        else if (value.m_tag == Json::BOOL)
+            bits = value.m_value.b;
+        else if (value.m_tag == Json::INT_NUMBER)
+            bits = static_cast<uint32_t>(value.m_value.i);
+        else if (value.m_tag == Json::NUMBER)
+            memcpy(&bits, &value.m_value.d, sizeof bits);
+        return bits;
+    }
+
+    static uint64_t mix(uint64_t h, uint64_t bits) {
+        h = (h ^ bits) * 0xff51afd7ed558ccdULL;
+        return h ^ (h >> 32);
+    }
+
+    static uint64_t identity(const Json &child) {
+        return mix(child.m_tag, scalar_bits(child));
+    }
+
+    static uint64_t hash(const Json &value) {
+        uint64_t h = value.m_tag;
+        if (value.m_tag == Json::STRING) {
+            const Json::string_ref text = value.string_ref_value();
+            return mix(h, hash_key(text.data, text.size));
+        }
+        if (value.m_tag == Json::ARRAY && value.node()->kind() == JsonValue::NUMBER_ARRAY) {
+            const auto *numbers = static_cast<const JsonNumberArray *>(value.node());
+            const Json::number_span span = numbers->number_span_value();
+            for (size_t i = 0; i < span.size; i++) {
+                uint64_t bits;
+                memcpy(&bits, &span.data[i], sizeof bits);
+                h = mix(h, bits + numbers->is_int(i));
+            }
+            return h;
+        }
+        if (value.m_tag == Json::ARRAY) {
+            for (const Json &item : value.array_items())
+                h = mix(h, identity(item));
+            return h;
+        }
+        for (const auto &entry : static_cast<const JsonObject *>(value.node())->entries())
+            h = mix(mix(h, hash_key(entry.first.data(), entry.first.size())),
+                    identity(entry.second));
+        return h;
+    }
+
+    static bool same(const Json &a, const Json &b) {
+        if (a.m_tag != b.m_tag)
+            return false;
+        if (a.m_tag == Json::STRING)
+            return same_key(a.string_ref_value(), b.string_ref_value());
+        if (a.m_tag == Json::ARRAY && (a.node()->kind() == JsonValue::NUMBER_ARRAY
+                                        || b.node()->kind() == JsonValue::NUMBER_ARRAY)) {
+            return a.node()->kind() == b.node()->kind()
+                && static_cast<const JsonNumberArray *>(a.node())->same(
+                       static_cast<const JsonNumberArray *>(b.node()));
+        }
+        if (a.m_tag == Json::ARRAY) {
+            const Json::array &x = a.array_items(), &y = b.array_items();
+            if (x.size() != y.size())
+                return false;
+            for (size_t i = 0; i < x.size(); i++) {
+                if (!identical(x[i], y[i]))
+                    return false;
+            }
+            return true;
+        }
+        const ObjectEntries &x = static_cast<const JsonObject *>(a.node())->entries();
+        const ObjectEntries &y = static_cast<const JsonObject *>(b.node())->entries();
+        if (x.size() != y.size())
+            return false;
+        for (size_t i = 0; i < x.size(); i++) {
+            if (!identical(x[i].second, y[i].second) || !(x[i].first == y[i].first))
+                return false;
+        }
+        return true;
+    }
+
+    void grow() {
+        m_mask = 2 * m_mask + 1;
+        m_slots.reset(new uint64_t[m_mask + 1]());
+        for (size_t i = 0; i < m_values.size(); i++) {
+            size_t slot = m_hashes[i] & m_mask;
+            while (m_slots[slot])
+                slot = (slot + 1) & m_mask;
+            m_slots[slot] = (m_hashes[i] & 0xffffffff00000000ULL) | (i + 1);
+        }
+    }
+
+    vector<Json> m_values;      // value number n is m_values[n - 1]
+    vector<uint64_t> m_hashes;  // and its hash is m_hashes[n - 1]
+    size_t m_mask;
+    std::unique_ptr<uint64_t[]> m_slots;
+};
+
+Json Json::dedupe() const {
+    ValueTable table;
+    return table.dedupe(*this);
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Parsing
+ */
+
+/* esc(c)
+ *
+ * Format char c suitable for printing in an error message.
+ */
+static inline string esc(char c) {
+    char buf[12];
+    if (static_cast<uint8_t>(c) >= 0x20 && static_cast<uint8_t>(c) <= 0x7f) {
+        snprintf(buf, sizeof buf, "'%c' (%d)", c, c);
+    } else {
+        snprintf(buf, sizeof buf, "(%d)", c);
+    }
+    return string(buf);
+}
+
+static inline bool in_range(long x, long lower, long upper) {
+    return (x >= lower && x <= upper);
+}
+
+/* find_string_special(s, i, size)
+ *
+ * Return the position of the first '"', '\\' or control character in s[i, size), or size if
+ * there is none. Everything before it can be copied into a parsed string verbatim.
+ */
+static inline bool is_string_special(char ch) {
+    return ch == '"' || ch == '\\' || static_cast<uint8_t>(ch) < 0x20;
+}
+
+static inline size_t find_string_special(const char *s, size_t i, size_t size) {
+#if JSON11_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; i + 16 <= size; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        const __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+        const int mask = _mm_movemask_epi8(special);
+        if (mask)
+            return i + trailing_zeroes(static_cast<uint64_t>(mask));
+    }
+#else
+    // Eight bytes at a time: a byte is flagged if it is below 0x20 or equal to '"' or '\\'
+    // (x ^ c has a zero byte where x has c). The exact position is found bytewise below.
+    const uint64_t ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t x;
+        memcpy(&x, s + i, sizeof x);
+        const uint64_t q = x ^ (ones * '"'), b = x ^ (ones * '\\');
+        if ((((x - ones * 0x20) & ~x) | ((q - ones) & ~q) | ((b - ones) & ~b)) & highs)
+            break;
+    }
+#endif
+    while (i < size && !is_string_special(s[i]))
+        i++;
+    return i;
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Number conversion
+ *
+ * parse_number() accumulates up to 19 significant decimal digits into a uint64_t and a power of
+ * ten as it scans, then turns them into a double without going back over the text:
+ *
+ *  - If both the mantissa and 10^exponent are exact doubles, one multiplication or division
+ *    is correctly rounded (Clinger's fast path).
+ *  - Otherwise the mantissa is multiplied by a 128-bit approximation of 5^exponent, which
+ *    gives the correctly rounded result directly (the Eisel-Lemire algorithm, as used by
+ *    fast_float).
+ *  - Numbers with more than 19 significant digits are rounded both ways; in the rare case the
+ *    two results differ, strtod() is used, with the '.' adjusted for the current locale.
+ */
+
+// 128-bit truncations of 5^q for q in [-342, 308], normalized so the top bit is set; high
+// word first.
+static const int smallest_power_of_five = -342;
+static const int largest_power_of_five = 308;
+static const uint64_t power_of_five_128[] = {
+    0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL,
+    0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL,
+    0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL,
+    0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL,
+    0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL,
+    0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL,
+    0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL,
+    0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL,
+    0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL,
+    0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL,
+    0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL,
+    0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL,
+    0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL,
+    0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL,
+    0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL,
+    0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL,
+    0x84a57695fe98746dULL, 0x014bb630f7604b57ULL,
+    0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL,
+    0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL,
+    0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL,
+    0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL,
+    0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL,
+    0xfd00b897478238d0ULL, 0x8920b098955522b4ULL,
+    0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL,
+    0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL,
+    0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL,
+    0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL,
+    0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL,
+    0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL,
+    0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL,
+    0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL,
+    0xeba09271e88d976bULL, 0xf7864a44c633682eULL,
+    0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL,
+    0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL,
+    0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL,
+    0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL,
+    0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL,
+    0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL,
+    0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL,
+    0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL,
+    0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL,
+    0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL,
+    0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL,
+    0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL,
+    0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL,
+    0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL,
+    0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL,
+    0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL,
+    0xa37fce126597973cULL, 0xe50ff107bab528a0ULL,
+    0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL,
+    0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL,
+    0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL,
+    0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL,
+    0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL,
+    0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL,
+    0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL,
+    0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL,
+    0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL,
+    0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL,
+    0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL,
+    0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL,
+    0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL,
+    0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL,
+    0x91376c36d99995beULL, 0x23100809b9c21fa1ULL,
+    0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL,
+    0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL,
+    0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL,
+    0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL,
+    0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL,
+    0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL,
+    0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL,
+    0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL,
+    0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL,
+    0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL,
+    0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL,
+    0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL,
+    0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL,
+    0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL,
+    0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL,
+    0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL,
+    0xc987434744ac874eULL, 0xa327ffb266b56220ULL,
+    0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL,
+    0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL,
+    0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL,
+    0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL,
+    0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL,
+    0xc0314325637a1939ULL, 0xfa911155fefb5308ULL,
+    0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL,
+    0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL,
+    0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL,
+    0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL,
+    0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL,
+    0xb749faed14125d36ULL, 0xcef980ec671f667bULL,
+    0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL,
+    0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL,
+    0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL,
+    0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL,
+    0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL,
+    0xaecc49914078536dULL, 0x58fae9f773886e18ULL,
+    0xda7f5bf590966848ULL, 0xaf39a475506a899eULL,
+    0x888f99797a5e012dULL, 0x6d8406c952429603ULL,
+    0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL,
+    0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL,
+    0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL,
+    0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL,
+    0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL,
+    0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL,
+    0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL,
+    0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL,
+    0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL,
+    0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL,
+    0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL,
+    0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL,
+    0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL,
+    0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL,
+    0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL,
+    0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL,
+    0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL,
+    0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL,
+    0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL,
+    0xb913179899f68584ULL, 0x28e2557b59846e3fULL,
+    0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL,
+    0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL,
+    0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL,
+    0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL,
+    0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL,
+    0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL,
+    0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL,
+    0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL,
+    0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL,
+    0xd77485cb25823ac7ULL, 0x7d633293366b828bULL,
+    0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL,
+    0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL,
+    0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL,
+    0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL,
+    0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL,
+    0xcd795be870516656ULL, 0x67902e276c921f8bULL,
+    0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL,
+    0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL,
+    0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL,
+    0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL,
+    0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL,
+    0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL,
+    0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL,
+    0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL,
+    0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL,
+    0xef340a98172aace4ULL, 0x86fb897116c87c34ULL,
+    0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL,
+    0xbae0a846d2195712ULL, 0x8974836059cca109ULL,
+    0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL,
+    0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL,
+    0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL,
+    0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL,
+    0x8e938662882af53eULL, 0x547eb47b7282ee9cULL,
+    0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL,
+    0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL,
+    0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL,
+    0xae0b158b4738705eULL, 0x9624ab50b148d445ULL,
+    0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL,
+    0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL,
+    0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL,
+    0xd47487cc8470652bULL, 0x7647c3200069671fULL,
+    0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL,
+    0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL,
+    0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL,
+    0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL,
+    0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL,
+    0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL,
+    0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL,
+    0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL,
+    0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL,
+    0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL,
+    0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL,
+    0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL,
+    0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL,
+    0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL,
+    0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL,
+    0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL,
+    0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL,
+    0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL,
+    0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL,
+    0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL,
+    0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL,
+    0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL,
+    0x8c974f7383725573ULL, 0x1e414218c73a13fbULL,
+    0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL,
+    0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL,
+    0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL,
+    0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL,
+    0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL,
+    0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL,
+    0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL,
+    0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL,
+    0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL,
+    0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL,
+    0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL,
+    0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL,
+    0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL,
+    0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL,
+    0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL,
+    0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL,
+    0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL,
+    0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL,
+    0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL,
+    0xbe89523386091465ULL, 0xf6bbb397f1135823ULL,
+    0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL,
+    0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL,
+    0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL,
+    0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL,
+    0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL,
+    0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL,
+    0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL,
+    0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL,
+    0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL,
+    0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL,
+    0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL,
+    0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL,
+    0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL,
+    0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL,
+    0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL,
+    0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL,
+    0x843610cb4bf160cbULL, 0xcedf722a585139baULL,
+    0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL,
+    0xce947a3da6a9273eULL, 0x733d226229feea32ULL,
+    0x811ccc668829b887ULL, 0x0806357d5a3f525fULL,
+    0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL,
+    0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL,
+    0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL,
+    0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL,
+    0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL,
+    0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL,
+    0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL,
+    0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL,
+    0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL,
+    0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL,
+    0xbbe226efb628afeaULL, 0x890489f70a55368bULL,
+    0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL,
+    0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL,
+    0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL,
+    0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL,
+    0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL,
+    0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL,
+    0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL,
+    0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL,
+    0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL,
+    0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL,
+    0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL,
+    0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL,
+    0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL,
+    0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL,
+    0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL,
+    0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL,
+    0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL,
+    0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL,
+    0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL,
+    0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL,
+    0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL,
+    0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL,
+    0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL,
+    0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL,
+    0xc24452da229b021bULL, 0xfbe85badce996168ULL,
+    0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL,
+    0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL,
+    0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL,
+    0xed246723473e3813ULL, 0x290123e9aab23b68ULL,
+    0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL,
+    0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL,
+    0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL,
+    0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL,
+    0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL,
+    0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL,
+    0x8d590723948a535fULL, 0x579c487e5a38ad0eULL,
+    0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL,
+    0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL,
+    0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL,
+    0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL,
+    0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL,
+    0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL,
+    0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL,
+    0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL,
+    0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL,
+    0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL,
+    0xcdb02555653131b6ULL, 0x3792f412cb06794dULL,
+    0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL,
+    0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL,
+    0xc8de047564d20a8bULL, 0xf245825a5a445275ULL,
+    0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL,
+    0x9ced737bb6c4183dULL, 0x55464dd69685606bULL,
+    0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL,
+    0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL,
+    0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL,
+    0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL,
+    0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL,
+    0x95a8637627989aadULL, 0xdde7001379a44aa8ULL,
+    0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL,
+    0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL,
+    0x9226712162ab070dULL, 0xcab3961304ca70e8ULL,
+    0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL,
+    0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL,
+    0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL,
+    0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL,
+    0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL,
+    0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL,
+    0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL,
+    0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL,
+    0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL,
+    0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL,
+    0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL,
+    0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL,
+    0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL,
+    0xcfb11ead453994baULL, 0x67de18eda5814af2ULL,
+    0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL,
+    0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL,
+    0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL,
+    0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL,
+    0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL,
+    0xc612062576589ddaULL, 0x95364afe032a819eULL,
+    0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL,
+    0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL,
+    0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL,
+    0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL,
+    0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL,
+    0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL,
+    0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL,
+    0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL,
+    0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL,
+    0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL,
+    0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL,
+    0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL,
+    0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL,
+    0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL,
+    0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL,
+    0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL,
+    0x89705f4136b4a597ULL, 0x31680a88f8953031ULL,
+    0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL,
+    0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL,
+    0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL,
+    0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL,
+    0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL,
+    0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL,
+    0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL,
+    0xccccccccccccccccULL, 0xcccccccccccccccdULL,
+    0x8000000000000000ULL, 0x0000000000000000ULL,
+    0xa000000000000000ULL, 0x0000000000000000ULL,
+    0xc800000000000000ULL, 0x0000000000000000ULL,
+    0xfa00000000000000ULL, 0x0000000000000000ULL,
+    0x9c40000000000000ULL, 0x0000000000000000ULL,
+    0xc350000000000000ULL, 0x0000000000000000ULL,
+    0xf424000000000000ULL, 0x0000000000000000ULL,
+    0x9896800000000000ULL, 0x0000000000000000ULL,
+    0xbebc200000000000ULL, 0x0000000000000000ULL,
+    0xee6b280000000000ULL, 0x0000000000000000ULL,
+    0x9502f90000000000ULL, 0x0000000000000000ULL,
+    0xba43b74000000000ULL, 0x0000000000000000ULL,
+    0xe8d4a51000000000ULL, 0x0000000000000000ULL,
+    0x9184e72a00000000ULL, 0x0000000000000000ULL,
+    0xb5e620f480000000ULL, 0x0000000000000000ULL,
+    0xe35fa931a0000000ULL, 0x0000000000000000ULL,
+    0x8e1bc9bf04000000ULL, 0x0000000000000000ULL,
+    0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL,
+    0xde0b6b3a76400000ULL, 0x0000000000000000ULL,
+    0x8ac7230489e80000ULL, 0x0000000000000000ULL,
+    0xad78ebc5ac620000ULL, 0x0000000000000000ULL,
+    0xd8d726b7177a8000ULL, 0x0000000000000000ULL,
+    0x878678326eac9000ULL, 0x0000000000000000ULL,
+    0xa968163f0a57b400ULL, 0x0000000000000000ULL,
+    0xd3c21bcecceda100ULL, 0x0000000000000000ULL,
+    0x84595161401484a0ULL, 0x0000000000000000ULL,
+    0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL,
+    0xcecb8f27f4200f3aULL, 0x0000000000000000ULL,
+    0x813f3978f8940984ULL, 0x4000000000000000ULL,
+    0xa18f07d736b90be5ULL, 0x5000000000000000ULL,
+    0xc9f2c9cd04674edeULL, 0xa400000000000000ULL,
+    0xfc6f7c4045812296ULL, 0x4d00000000000000ULL,
+    0x9dc5ada82b70b59dULL, 0xf020000000000000ULL,
+    0xc5371912364ce305ULL, 0x6c28000000000000ULL,
+    0xf684df56c3e01bc6ULL, 0xc732000000000000ULL,
+    0x9a130b963a6c115cULL, 0x3c7f400000000000ULL,
+    0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL,
+    0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL,
+    0x96769950b50d88f4ULL, 0x1314448000000000ULL,
+    0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL,
+    0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL,
+    0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL,
+    0xb7abc627050305adULL, 0xf14a3d9e40000000ULL,
+    0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL,
+    0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL,
+    0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL,
+    0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL,
+    0x8c213d9da502de45ULL, 0x4526f422cc340000ULL,
+    0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL,
+    0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL,
+    0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL,
+    0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL,
+    0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL,
+    0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL,
+    0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL,
+    0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL,
+    0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL,
+    0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL,
+    0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL,
+    0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL,
+    0x9f4f2726179a2245ULL, 0x01d762422c946590ULL,
+    0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL,
+    0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL,
+    0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL,
+    0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL,
+    0xf316271c7fc3908aULL, 0x8bef464e3945ef7aULL,
+    0x97edd871cfda3a56ULL, 0x97758bf0e3cbb5acULL,
+    0xbde94e8e43d0c8ecULL, 0x3d52eeed1cbea317ULL,
+    0xed63a231d4c4fb27ULL, 0x4ca7aaa863ee4bddULL,
+    0x945e455f24fb1cf8ULL, 0x8fe8caa93e74ef6aULL,
+    0xb975d6b6ee39e436ULL, 0xb3e2fd538e122b44ULL,
+    0xe7d34c64a9c85d44ULL, 0x60dbbca87196b616ULL,
+    0x90e40fbeea1d3a4aULL, 0xbc8955e946fe31cdULL,
+    0xb51d13aea4a488ddULL, 0x6babab6398bdbe41ULL,
+    0xe264589a4dcdab14ULL, 0xc696963c7eed2dd1ULL,
+    0x8d7eb76070a08aecULL, 0xfc1e1de5cf543ca2ULL,
+    0xb0de65388cc8ada8ULL, 0x3b25a55f43294bcbULL,
+    0xdd15fe86affad912ULL, 0x49ef0eb713f39ebeULL,
+    0x8a2dbf142dfcc7abULL, 0x6e3569326c784337ULL,
+    0xacb92ed9397bf996ULL, 0x49c2c37f07965404ULL,
+    0xd7e77a8f87daf7fbULL, 0xdc33745ec97be906ULL,
+    0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL,
+    0xa8acd7c0222311bcULL, 0xc40832ea0d68ce0cULL,
+    0xd2d80db02aabd62bULL, 0xf50a3fa490c30190ULL,
+    0x83c7088e1aab65dbULL, 0x792667c6da79e0faULL,
+    0xa4b8cab1a1563f52ULL, 0x577001b891185938ULL,
+    0xcde6fd5e09abcf26ULL, 0xed4c0226b55e6f86ULL,
+    0x80b05e5ac60b6178ULL, 0x544f8158315b05b4ULL,
+    0xa0dc75f1778e39d6ULL, 0x696361ae3db1c721ULL,
+    0xc913936dd571c84cULL, 0x03bc3a19cd1e38e9ULL,
+    0xfb5878494ace3a5fULL, 0x04ab48a04065c723ULL,
+    0x9d174b2dcec0e47bULL, 0x62eb0d64283f9c76ULL,
+    0xc45d1df942711d9aULL, 0x3ba5d0bd324f8394ULL,
+    0xf5746577930d6500ULL, 0xca8f44ec7ee36479ULL,
+    0x9968bf6abbe85f20ULL, 0x7e998b13cf4e1ecbULL,
+    0xbfc2ef456ae276e8ULL, 0x9e3fedd8c321a67eULL,
+    0xefb3ab16c59b14a2ULL, 0xc5cfe94ef3ea101eULL,
+    0x95d04aee3b80ece5ULL, 0xbba1f1d158724a12ULL,
+    0xbb445da9ca61281fULL, 0x2a8a6e45ae8edc97ULL,
+    0xea1575143cf97226ULL, 0xf52d09d71a3293bdULL,
+    0x924d692ca61be758ULL, 0x593c2626705f9c56ULL,
+    0xb6e0c377cfa2e12eULL, 0x6f8b2fb00c77836cULL,
+    0xe498f455c38b997aULL, 0x0b6dfb9c0f956447ULL,
+    0x8edf98b59a373fecULL, 0x4724bd4189bd5eacULL,
+    0xb2977ee300c50fe7ULL, 0x58edec91ec2cb657ULL,
+    0xdf3d5e9bc0f653e1ULL, 0x2f2967b66737e3edULL,
+    0x8b865b215899f46cULL, 0xbd79e0d20082ee74ULL,
+    0xae67f1e9aec07187ULL, 0xecd8590680a3aa11ULL,
+    0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL,
+    0x884134fe908658b2ULL, 0x3109058d147fdcddULL,
+    0xaa51823e34a7eedeULL, 0xbd4b46f0599fd415ULL,
+    0xd4e5e2cdc1d1ea96ULL, 0x6c9e18ac7007c91aULL,
+    0x850fadc09923329eULL, 0x03e2cf6bc604ddb0ULL,
+    0xa6539930bf6bff45ULL, 0x84db8346b786151cULL,
+    0xcfe87f7cef46ff16ULL, 0xe612641865679a63ULL,
+    0x81f14fae158c5f6eULL, 0x4fcb7e8f3f60c07eULL,
+    0xa26da3999aef7749ULL, 0xe3be5e330f38f09dULL,
+    0xcb090c8001ab551cULL, 0x5cadf5bfd3072cc5ULL,
+    0xfdcb4fa002162a63ULL, 0x73d9732fc7c8f7f6ULL,
+    0x9e9f11c4014dda7eULL, 0x2867e7fddcdd9afaULL,
+    0xc646d63501a1511dULL, 0xb281e1fd541501b8ULL,
+    0xf7d88bc24209a565ULL, 0x1f225a7ca91a4226ULL,
+    0x9ae757596946075fULL, 0x3375788de9b06958ULL,
+    0xc1a12d2fc3978937ULL, 0x0052d6b1641c83aeULL,
+    0xf209787bb47d6b84ULL, 0xc0678c5dbd23a49aULL,
+    0x9745eb4d50ce6332ULL, 0xf840b7ba963646e0ULL,
+    0xbd176620a501fbffULL, 0xb650e5a93bc3d898ULL,
+    0xec5d3fa8ce427affULL, 0xa3e51f138ab4cebeULL,
+    0x93ba47c980e98cdfULL, 0xc66f336c36b10137ULL,
+    0xb8a8d9bbe123f017ULL, 0xb80b0047445d4184ULL,
+    0xe6d3102ad96cec1dULL, 0xa60dc059157491e5ULL,
+    0x9043ea1ac7e41392ULL, 0x87c89837ad68db2fULL,
+    0xb454e4a179dd1877ULL, 0x29babe4598c311fbULL,
+    0xe16a1dc9d8545e94ULL, 0xf4296dd6fef3d67aULL,
+    0x8ce2529e2734bb1dULL, 0x1899e4a65f58660cULL,
+    0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL,
+    0xdc21a1171d42645dULL, 0x76707543f4fa1f73ULL,
+    0x899504ae72497ebaULL, 0x6a06494a791c53a8ULL,
+    0xabfa45da0edbde69ULL, 0x0487db9d17636892ULL,
+    0xd6f8d7509292d603ULL, 0x45a9d2845d3c42b6ULL,
+    0x865b86925b9bc5c2ULL, 0x0b8a2392ba45a9b2ULL,
+    0xa7f26836f282b732ULL, 0x8e6cac7768d7141eULL,
+    0xd1ef0244af2364ffULL, 0x3207d795430cd926ULL,
+    0x8335616aed761f1fULL, 0x7f44e6bd49e807b8ULL,
+    0xa402b9c5a8d3a6e7ULL, 0x5f16206c9c6209a6ULL,
+    0xcd036837130890a1ULL, 0x36dba887c37a8c0fULL,
+    0x802221226be55a64ULL, 0xc2494954da2c9789ULL,
+    0xa02aa96b06deb0fdULL, 0xf2db9baa10b7bd6cULL,
+    0xc83553c5c8965d3dULL, 0x6f92829494e5acc7ULL,
+    0xfa42a8b73abbf48cULL, 0xcb772339ba1f17f9ULL,
+    0x9c69a97284b578d7ULL, 0xff2a760414536efbULL,
+    0xc38413cf25e2d70dULL, 0xfef5138519684abaULL,
+    0xf46518c2ef5b8cd1ULL, 0x7eb258665fc25d69ULL,
+    0x98bf2f79d5993802ULL, 0xef2f773ffbd97a61ULL,
+    0xbeeefb584aff8603ULL, 0xaafb550ffacfd8faULL,
+    0xeeaaba2e5dbf6784ULL, 0x95ba2a53f983cf38ULL,
+    0x952ab45cfa97a0b2ULL, 0xdd945a747bf26183ULL,
+    0xba756174393d88dfULL, 0x94f971119aeef9e4ULL,
+    0xe912b9d1478ceb17ULL, 0x7a37cd5601aab85dULL,
+    0x91abb422ccb812eeULL, 0xac62e055c10ab33aULL,
+    0xb616a12b7fe617aaULL, 0x577b986b314d6009ULL,
+    0xe39c49765fdf9d94ULL, 0xed5a7e85fda0b80bULL,
+    0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL,
+    0xb1d219647ae6b31cULL, 0x596eb2d8ae258fc8ULL,
+    0xde469fbd99a05fe3ULL, 0x6fca5f8ed9aef3bbULL,
+    0x8aec23d680043beeULL, 0x25de7bb9480d5854ULL,
+    0xada72ccc20054ae9ULL, 0xaf561aa79a10ae6aULL,
+    0xd910f7ff28069da4ULL, 0x1b2ba1518094da04ULL,
+    0x87aa9aff79042286ULL, 0x90fb44d2f05d0842ULL,
+    0xa99541bf57452b28ULL, 0x353a1607ac744a53ULL,
+    0xd3fa922f2d1675f2ULL, 0x42889b8997915ce8ULL,
+    0x847c9b5d7c2e09b7ULL, 0x69956135febada11ULL,
+    0xa59bc234db398c25ULL, 0x43fab9837e699095ULL,
+    0xcf02b2c21207ef2eULL, 0x94f967e45e03f4bbULL,
+    0x8161afb94b44f57dULL, 0x1d1be0eebac278f5ULL,
+    0xa1ba1ba79e1632dcULL, 0x6462d92a69731732ULL,
+    0xca28a291859bbf93ULL, 0x7d7b8f7503cfdcfeULL,
+    0xfcb2cb35e702af78ULL, 0x5cda735244c3d43eULL,
+    0x9defbf01b061adabULL, 0x3a0888136afa64a7ULL,
+    0xc56baec21c7a1916ULL, 0x088aaa1845b8fdd0ULL,
+    0xf6c69a72a3989f5bULL, 0x8aad549e57273d45ULL,
+    0x9a3c2087a63f6399ULL, 0x36ac54e2f678864bULL,
+    0xc0cb28a98fcf3c7fULL, 0x84576a1bb416a7ddULL,
+    0xf0fdf2d3f3c30b9fULL, 0x656d44a2a11c51d5ULL,
+    0x969eb7c47859e743ULL, 0x9f644ae5a4b1b325ULL,
+    0xbc4665b596706114ULL, 0x873d5d9f0dde1feeULL,
+    0xeb57ff22fc0c7959ULL, 0xa90cb506d155a7eaULL,
+    0x9316ff75dd87cbd8ULL, 0x09a7f12442d588f2ULL,
+    0xb7dcbf5354e9beceULL, 0x0c11ed6d538aeb2fULL,
+    0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL,
+    0x8fa475791a569d10ULL, 0xf96e017d694487bcULL,
+    0xb38d92d760ec4455ULL, 0x37c981dcc395a9acULL,
+    0xe070f78d3927556aULL, 0x85bbe253f47b1417ULL,
+    0x8c469ab843b89562ULL, 0x93956d7478ccec8eULL,
+    0xaf58416654a6babbULL, 0x387ac8d1970027b2ULL,
+    0xdb2e51bfe9d0696aULL, 0x06997b05fcc0319eULL,
+    0x88fcf317f22241e2ULL, 0x441fece3bdf81f03ULL,
+    0xab3c2fddeeaad25aULL, 0xd527e81cad7626c3ULL,
+    0xd60b3bd56a5586f1ULL, 0x8a71e223d8d3b074ULL,
+    0x85c7056562757456ULL, 0xf6872d5667844e49ULL,
+    0xa738c6bebb12d16cULL, 0xb428f8ac016561dbULL,
+    0xd106f86e69d785c7ULL, 0xe13336d701beba52ULL,
+    0x82a45b450226b39cULL, 0xecc0024661173473ULL,
+    0xa34d721642b06084ULL, 0x27f002d7f95d0190ULL,
+    0xcc20ce9bd35c78a5ULL, 0x31ec038df7b441f4ULL,
+    0xff290242c83396ceULL, 0x7e67047175a15271ULL,
+    0x9f79a169bd203e41ULL, 0x0f0062c6e984d386ULL,
+    0xc75809c42c684dd1ULL, 0x52c07b78a3e60868ULL,
+    0xf92e0c3537826145ULL, 0xa7709a56ccdf8a82ULL,
+    0x9bbcc7a142b17ccbULL, 0x88a66076400bb691ULL,
+    0xc2abf989935ddbfeULL, 0x6acff893d00ea435ULL,
+    0xf356f7ebf83552feULL, 0x0583f6b8c4124d43ULL,
+    0x98165af37b2153deULL, 0xc3727a337a8b704aULL,
+    0xbe1bf1b059e9a8d6ULL, 0x744f18c0592e4c5cULL,
+    0xeda2ee1c7064130cULL, 0x1162def06f79df73ULL,
+    0x9485d4d1c63e8be7ULL, 0x8addcb5645ac2ba8ULL,
+    0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL,
+    0xe8111c87c5c1ba99ULL, 0xc8fa8db6ccdd0437ULL,
+    0x910ab1d4db9914a0ULL, 0x1d9c9892400a22a2ULL,
+    0xb54d5e4a127f59c8ULL, 0x2503beb6d00cab4bULL,
+    0xe2a0b5dc971f303aULL, 0x2e44ae64840fd61dULL,
+    0x8da471a9de737e24ULL, 0x5ceaecfed289e5d2ULL,
+    0xb10d8e1456105dadULL, 0x7425a83e872c5f47ULL,
+    0xdd50f1996b947518ULL, 0xd12f124e28f77719ULL,
+    0x8a5296ffe33cc92fULL, 0x82bd6b70d99aaa6fULL,
+    0xace73cbfdc0bfb7bULL, 0x636cc64d1001550bULL,
+    0xd8210befd30efa5aULL, 0x3c47f7e05401aa4eULL,
+    0x8714a775e3e95c78ULL, 0x65acfaec34810a71ULL,
+    0xa8d9d1535ce3b396ULL, 0x7f1839a741a14d0dULL,
+    0xd31045a8341ca07cULL, 0x1ede48111209a050ULL,
+    0x83ea2b892091e44dULL, 0x934aed0aab460432ULL,
+    0xa4e4b66b68b65d60ULL, 0xf81da84d5617853fULL,
+    0xce1de40642e3f4b9ULL, 0x36251260ab9d668eULL,
+    0x80d2ae83e9ce78f3ULL, 0xc1d72b7c6b426019ULL,
+    0xa1075a24e4421730ULL, 0xb24cf65b8612f81fULL,
+    0xc94930ae1d529cfcULL, 0xdee033f26797b627ULL,
+    0xfb9b7cd9a4a7443cULL, 0x169840ef017da3b1ULL,
+    0x9d412e0806e88aa5ULL, 0x8e1f289560ee864eULL,
+    0xc491798a08a2ad4eULL, 0xf1a6f2bab92a27e2ULL,
+    0xf5b5d7ec8acb58a2ULL, 0xae10af696774b1dbULL,
+    0x9991a6f3d6bf1765ULL, 0xacca6da1e0a8ef29ULL,
+    0xbff610b0cc6edd3fULL, 0x17fd090a58d32af3ULL,
+    0xeff394dcff8a948eULL, 0xddfc4b4cef07f5b0ULL,
+    0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL,
+    0xbb764c4ca7a4440fULL, 0x9d6d1ad41abe37f1ULL,
+    0xea53df5fd18d5513ULL, 0x84c86189216dc5edULL,
+    0x92746b9be2f8552cULL, 0x32fd3cf5b4e49bb4ULL,
+    0xb7118682dbb66a77ULL, 0x3fbc8c33221dc2a1ULL,
+    0xe4d5e82392a40515ULL, 0x0fabaf3feaa5334aULL,
+    0x8f05b1163ba6832dULL, 0x29cb4d87f2a7400eULL,
+    0xb2c71d5bca9023f8ULL, 0x743e20e9ef511012ULL,
+    0xdf78e4b2bd342cf6ULL, 0x914da9246b255416ULL,
+    0x8bab8eefb6409c1aULL, 0x1ad089b6c2f7548eULL,
+    0xae9672aba3d0c320ULL, 0xa184ac2473b529b1ULL,
+    0xda3c0f568cc4f3e8ULL, 0xc9e5d72d90a2741eULL,
+    0x8865899617fb1871ULL, 0x7e2fa67c7a658892ULL,
+    0xaa7eebfb9df9de8dULL, 0xddbb901b98feeab7ULL,
+    0xd51ea6fa85785631ULL, 0x552a74227f3ea565ULL,
+    0x8533285c936b35deULL, 0xd53a88958f87275fULL,
+    0xa67ff273b8460356ULL, 0x8a892abaf368f137ULL,
+    0xd01fef10a657842cULL, 0x2d2b7569b0432d85ULL,
+    0x8213f56a67f6b29bULL, 0x9c3b29620e29fc73ULL,
+    0xa298f2c501f45f42ULL, 0x8349f3ba91b47b8fULL,
+    0xcb3f2f7642717713ULL, 0x241c70a936219a73ULL,
+    0xfe0efb53d30dd4d7ULL, 0xed238cd383aa0110ULL,
+    0x9ec95d1463e8a506ULL, 0xf4363804324a40aaULL,
+    0xc67bb4597ce2ce48ULL, 0xb143c6053edcd0d5ULL,
+    0xf81aa16fdc1b81daULL, 0xdd94b7868e94050aULL,
+    0x9b10a4e5e9913128ULL, 0xca7cf2b4191c8326ULL,
+    0xc1d4ce1f63f57d72ULL, 0xfd1c2f611f63a3f0ULL,
+    0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL,
+    0x976e41088617ca01ULL, 0xd5be0503e085d813ULL,
+    0xbd49d14aa79dbc82ULL, 0x4b2d8644d8a74e18ULL,
+    0xec9c459d51852ba2ULL, 0xddf8e7d60ed1219eULL,
+    0x93e1ab8252f33b45ULL, 0xcabb90e5c942b503ULL,
+    0xb8da1662e7b00a17ULL, 0x3d6a751f3b936243ULL,
+    0xe7109bfba19c0c9dULL, 0x0cc512670a783ad4ULL,
+    0x906a617d450187e2ULL, 0x27fb2b80668b24c5ULL,
+    0xb484f9dc9641e9daULL, 0xb1f9f660802dedf6ULL,
+    0xe1a63853bbd26451ULL, 0x5e7873f8a0396973ULL,
+    0x8d07e33455637eb2ULL, 0xdb0b487b6423e1e8ULL,
+    0xb049dc016abc5e5fULL, 0x91ce1a9a3d2cda62ULL,
+    0xdc5c5301c56b75f7ULL, 0x7641a140cc7810fbULL,
+    0x89b9b3e11b6329baULL, 0xa9e904c87fcb0a9dULL,
+    0xac2820d9623bf429ULL, 0x546345fa9fbdcd44ULL,
+    0xd732290fbacaf133ULL, 0xa97c177947ad4095ULL,
+    0x867f59a9d4bed6c0ULL, 0x49ed8eabcccc485dULL,
+    0xa81f301449ee8c70ULL, 0x5c68f256bfff5a74ULL,
+    0xd226fc195c6a2f8cULL, 0x73832eec6fff3111ULL,
+    0x83585d8fd9c25db7ULL, 0xc831fd53c5ff7eabULL,
+    0xa42e74f3d032f525ULL, 0xba3e7ca8b77f5e55ULL,
+    0xcd3a1230c43fb26fULL, 0x28ce1bd2e55f35ebULL,
+    0x80444b5e7aa7cf85ULL, 0x7980d163cf5b81b3ULL,
+    0xa0555e361951c366ULL, 0xd7e105bcc332621fULL,
+    0xc86ab5c39fa63440ULL, 0x8dd9472bf3fefaa7ULL,
+    0xfa856334878fc150ULL, 0xb14f98f6f0feb951ULL,
+    0x9c935e00d4b9d8d2ULL, 0x6ed1bf9a569f33d3ULL,
+    0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL,
+    0xf4a642e14c6262c8ULL, 0xcd27bb612758c0faULL,
+    0x98e7e9cccfbd7dbdULL, 0x8038d51cb897789cULL,
+    0xbf21e44003acdd2cULL, 0xe0470a63e6bd56c3ULL,
+    0xeeea5d5004981478ULL, 0x1858ccfce06cac74ULL,
+    0x95527a5202df0ccbULL, 0x0f37801e0c43ebc8ULL,
+    0xbaa718e68396cffdULL, 0xd30560258f54e6baULL,
+    0xe950df20247c83fdULL, 0x47c6b82ef32a2069ULL,
+    0x91d28b7416cdd27eULL, 0x4cdc331d57fa5441ULL,
+    0xb6472e511c81471dULL, 0xe0133fe4adf8e952ULL,
+    0xe3d8f9e563a198e5ULL, 0x58180fddd97723a6ULL,
+    0x8e679c2f5e44ff8fULL, 0x570f09eaa7ea7648ULL,
+};
+
+static inline int leading_zeroes(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long r;
+    _BitScanReverse64(&r, x);
+    return 63 - static_cast<int>(r);
+#else
+    int n = 0;
+    while (!(x & (uint64_t(1) << 63))) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Full 64x64 -> 128-bit product.
+static inline void full_multiplication(uint64_t a, uint64_t b, uint64_t &high, uint64_t &low) {
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+    high = static_cast<uint64_t>(r >> 64);
+    low = static_cast<uint64_t>(r);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    low = _umul128(a, b, &high);
+#else
+    const uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+    const uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+    const uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    high = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    low = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+#endif
+}
+
+/* eisel_lemire(q, w)
+ *
+ * Return the bits of the double nearest to w * 10^q, for w != 0. Values too small or too large
+ * for a double come out as zero or infinity.
+ */
+static uint64_t eisel_lemire(int64_t q, uint64_t w) {
+    const int mantissa_bits = 52;
+    const int64_t infinite_power = 0x7FF;
+    if (q < smallest_power_of_five)
+        return 0;
+    if (q > largest_power_of_five)
+        return uint64_t(infinite_power) << mantissa_bits;
+
+    const int lz = leading_zeroes(w);
+    w <<= lz;
+
+    // Only the top 55 bits of the product matter. If the bits below them in the high word are
+    // all ones, a carry from the next 64 bits of the power could still change them.
+    const size_t index = 2 * static_cast<size_t>(q - smallest_power_of_five);
+    uint64_t high, low;
+    full_multiplication(w, power_of_five_128[index], high, low);
+    const uint64_t precision_mask = uint64_t(0xFFFFFFFFFFFFFFFF) >> (mantissa_bits + 3);
+    if ((high & precision_mask) == precision_mask) {
+        uint64_t second_high, second_low;
+        full_multiplication(w, power_of_five_128[index + 1], second_high, second_low);
+        low += second_high;
+        if (second_high > low)
+            high++;
+    }
+
+    const int upperbit = static_cast<int>(high >> 63);
+    const int shift = upperbit + 64 - mantissa_bits - 3;
+    uint64_t mantissa = high >> shift;
+    // floor(log2(10^q)) + 63, plus the double exponent bias.
+    int64_t power2 = (((152170 + 65536) * q) >> 16) + 63 + upperbit - lz + 1023;
+
+    if (power2 <= 0) {
+        // Subnormal, or zero.
+        if (-power2 + 1 >= 64)
+            return 0;
+        mantissa >>= -power2 + 1;
+        mantissa += (mantissa & 1);
+        mantissa >>= 1;
+        power2 = (mantissa < (uint64_t(1) << mantissa_bits)) ? 0 : 1;
+        return (uint64_t(power2) << mantissa_bits) | (mantissa & ((uint64_t(1) << mantissa_bits) - 1));
+    }
+
+    // The product is exact for small q, so an exact halfway case must round to even rather
+    // than up.
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high)
+        mantissa &= ~uint64_t(1);
+
+    mantissa += (mantissa & 1);
+    mantissa >>= 1;
+    if (mantissa >= (uint64_t(2) << mantissa_bits)) {
+        mantissa = uint64_t(1) << mantissa_bits;
+        power2++;
+    }
+    mantissa &= ~(uint64_t(1) << mantissa_bits);
+    if (power2 >= infinite_power)
+        return uint64_t(infinite_power) << mantissa_bits;
+    return (uint64_t(power2) << mantissa_bits) | mantissa;
+}
+
+static inline double bits_to_double(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+/* strtod_c_locale(begin, len)
+ *
+ * strtod() for a JSON number, whatever the current locale's decimal point.
+ */
+static double strtod_c_locale(const char *begin, size_t len) {
+    string number(begin, len);
+    const char *point = localeconv()->decimal_point;
+    if (point && std::strcmp(point, ".") != 0) {
+        const size_t pos = number.find('.');
+        if (pos != string::npos)
+            number.replace(pos, 1, point);
+    }
+    return std::strtod(number.c_str(), nullptr);
+}
+
+/* decimal_to_double(negative, mantissa, exponent, truncated, begin, len)
+ *
+ * Convert mantissa * 10^exponent to the nearest double. If truncated, mantissa holds only the
+ * first 19 significant digits of the number, whose text is [begin, begin + len).
+ */
+static double decimal_to_double(bool negative, uint64_t mantissa, int64_t exponent,
+                                bool truncated, const char *begin, size_t len) {
+    double value;
+    if (mantissa == 0) {
+        value = 0;
+    } else if (truncated) {
+        // The true value lies between the two candidates; if they agree, so does it.
+        const uint64_t bits = eisel_lemire(exponent, mantissa);
+        if (bits != eisel_lemire(exponent, mantissa + 1))
+            return strtod_c_locale(begin, len);
+        value = bits_to_double(bits);
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD == 0
+    } else if (exponent >= -22 && exponent <= 22 && mantissa <= (uint64_t(1) << 53)) {
+        static const double exact_powers_of_ten[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+        };
+        value = static_cast<double>(mantissa);
+        if (exponent < 0)
+            value /= exact_powers_of_ten[-exponent];
+        else
+            value *= exact_powers_of_ten[exponent];
+#endif
+    } else {
+        value = bits_to_double(eisel_lemire(exponent, mantissa));
+    }
+    return negative ? -value : value;
 }
 
 namespace {
@@ -353,6 +2795,12 @@ struct JsonParser final {
     string &err;
     bool failed;
     const JsonParse strategy;
+    JsonArena *arena;
+    size_t object_index_threshold;
+    size_t number_array_threshold;
+    const std::shared_ptr<const string> *buffer;
+    const std::shared_ptr<KeyTable> *keys;
+    ValueTable *values;
 
     /* fail(msg, err_ret = Json())
      *
@@ -370,12 +2818,39 @@ struct JsonParser final {
         return err_ret;
     }
 
+    static bool is_space(char ch) {
+        return ch == ' ' || ch == '\r' || ch == '\n' || ch == '\t';
+    }
+
     /* consume_whitespace()
      *
-     * Advance until the current character is non-whitespace.
+     * Advance until the current character is non-whitespace. Compact input has none, or a
+     * single space after ':' and ','; longer runs, such as a line break and indentation in
+     * pretty-printed input, are skipped 16 bytes at a time where SSE2 is available.
      */
     void consume_whitespace() {
-        while (str[i] == ' ' || str[i] == '\r' || str[i] == '\n' || str[i] == '\t')
+        if (!is_space(str[i]))
+            return;
+        if (!is_space(str[++i]))
+            return;
+#if JSON11_SSE2
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        const __m128i tab = _mm_set1_epi8('\t');
+        for (; i + 16 <= str.size(); i += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str.data() + i));
+            const __m128i is_ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, cr)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, tab)));
+            const int other = ~_mm_movemask_epi8(is_ws) & 0xffff;
+            if (other) {
+                i += trailing_zeroes(static_cast<uint64_t>(other));
+                return;
+            }
+        }
+#endif
+        while (is_space(str[i]))
             i++;
     }
 
@@ -473,38 +2948,75 @@ struct JsonParser final {
         }
     }
 
+    /* parse_key(previous_key)
+     *
+     * Parse an object key, starting at the current position. A key with nothing to unescape,
+     * as nearly all are, is taken straight from the input. With a key table, long keys are
+     * interned; previous_key is the table's number for the last one in the same object.
+     */
+    ObjectKey parse_key(uint32_t &previous_key) {
+        string unescaped;
+        Json::string_ref text;
+        const size_t end = find_string_special(str.data(), i, str.size());
+        if (end < str.size() && str[end] == '"') {
+            text = Json::string_ref(str.data() + i, end - i);
+            i = end + 1;
+        } else {
+            parse_string(unescaped);
+            text = unescaped;
+        }
+        if (keys && text.size > ObjectKey::inline_capacity) {
+            text = (*keys)->intern(text.data, text.size, previous_key);
+            return ObjectKey::view(text.data, text.size);
+        }
+        return ObjectKey(text.data, text.size);
+    }
+
     /* parse_string()
      *
      * Parse a string, starting at the current position.
      */
     string parse_string() {
         string out;
+        parse_string(out);
+        return out;
+    }
+
+    /* parse_string(out)
+     *
+     * Parse a string, starting at the current position, into out (which is cleared first so
+     * that callers can reuse its capacity). Return false on error.
+     */
+    bool parse_string(string &out) {
+        out.clear();
         long last_escaped_codepoint = -1;
         while (true) {
             if (i == str.size())
-                return fail("unexpected end of input in string", "");
+                return fail("unexpected end of input in string", false);
+
+            // The usual case: a run of non-escaped characters, copied in one go
+            const size_t run_end = find_string_special(str.data(), i, str.size());
+            if (run_end != i) {
+                encode_utf8(last_escaped_codepoint, out);
+                last_escaped_codepoint = -1;
+                out.append(str, i, run_end - i);
+                i = run_end;
+                continue;
+            }
 
             char ch = str[i++];
 
             if (ch == '"') {
                 encode_utf8(last_escaped_codepoint, out);
-                return out;
+                return true;
             }
 
             if (in_range(ch, 0, 0x1f))
-                return fail("unescaped " + esc(ch) + " in string", "");
-
-            // The usual case: non-escaped characters
-            if (ch != '\\') {
-                encode_utf8(last_escaped_codepoint, out);
-                last_escaped_codepoint = -1;
-                out += ch;
-                continue;
-            }
+                return fail("unescaped " + esc(ch) + " in string", false);
 
             // Handle escapes
             if (i == str.size())
-                return fail("unexpected end of input in string", "");
+                return fail("unexpected end of input in string", false);
 
             ch = str[i++];
 
@@ -515,12 +3027,12 @@ struct JsonParser final {
                 // relies on std::string returning the terminating NUL when
                 // accessing str[length]. Checking here reduces brittleness.
                 if (esc.length() < 4) {
-                    return fail("bad \\u escape: " + esc, "");
+                    return fail("bad \\u escape: " + esc, false);
                 }
                 for (size_t j = 0; j < 4; j++) {
                     if (!in_range(esc[j], 'a', 'f') && !in_range(esc[j], 'A', 'F')
                             && !in_range(esc[j], '0', '9'))
-                        return fail("bad \\u escape: " + esc, "");
+                        return fail("bad \\u escape: " + esc, false);
                 }
 
                 long codepoint = strtol(esc.data(), nullptr, 16);
@@ -561,7 +3073,7 @@ struct JsonParser final {
             } else if (ch == '"' || ch == '\\' || ch == '/') {
                 out += ch;
             } else {
-                return fail("invalid escape character " + esc(ch), "");
+                return fail("invalid escape character " + esc(ch), false);
             }
         }
     }
@@ -571,167 +3083,468 @@ struct JsonParser final {
      * Parse a double.
      */
     Json parse_number() {
+        double value;
+        bool is_int;
+        if (!parse_number(value, is_int))
+            return Json();
+        if (is_int)
+            return static_cast<int>(value);
+        return value;
+    }
+
+    /* parse_number(value, is_int)
+     *
+     * Parse a number, starting at the current position. is_int is set if the number has no
+     * fraction or exponent and fits in an int. Return false on error.
+     */
+    bool parse_number(double &value, bool &is_int) {
         size_t start_pos = i;
+        is_int = false;
+
+        // Significant digits are accumulated into mantissa as they are scanned; once there
+        // are 19 of them, later digits only move the decimal exponent.
+        const bool negative = (str[i] == '-');
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int64_t exponent = 0;
+        bool truncated = false;
+        auto add_digit = [&](char ch, bool fraction) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(ch - '0');
+                if (mantissa != 0)
+                    digits++;
+                if (fraction)
+                    exponent--;
+            } else {
+                truncated |= (ch != '0');
+                if (!fraction)
+                    exponent++;
+            }
+        };
 
-        if (str[i] == '-')
+        if (negative)
             i++;
 
         // Integer part
         if (str[i] == '0') {
             i++;
             if (in_range(str[i], '0', '9'))
-                return fail("leading 0s not permitted in numbers");
+                return fail("leading 0s not permitted in numbers", false);
         } else if (in_range(str[i], '1', '9')) {
-            i++;
             while (in_range(str[i], '0', '9'))
-                i++;
+                add_digit(str[i++], false);
         } else {
-            return fail("invalid " + esc(str[i]) + " in number");
+            return fail("invalid " + esc(str[i]) + " in number", false);
         }
 
         if (str[i] != '.' && str[i] != 'e' && str[i] != 'E'
                 && (i - start_pos) <= static_cast<size_t>(std::numeric_limits<int>::digits10)) {
-            return std::atoi(str.c_str() + start_pos);
+            value = negative ? -static_cast<double>(mantissa) : static_cast<double>(mantissa);
+            is_int = true;
+            return true;
         }
 
         // Decimal part
         if (str[i] == '.') {
             i++;
             if (!in_range(str[i], '0', '9'))
-                return fail("at least one digit required in fractional part");
+                return fail("at least one digit required in fractional part", false);
+
+            while (in_range(str[i], '0', '9'))
+                add_digit(str[i++], true);
+        }
+
+        // Exponent part
+        if (str[i] == 'e' || str[i] == 'E') {
+            i++;
+
+            bool negative_exponent = false;
+            if (str[i] == '+' || str[i] == '-')
+                negative_exponent = (str[i++] == '-');
+
+            if (!in_range(str[i], '0', '9'))
+                return fail("at least one digit required in exponent", false);
+
+            // Anything beyond a few thousand is zero or infinity anyway.
+            int64_t exp_value = 0;
+            while (in_range(str[i], '0', '9')) {
+                if (exp_value < 100000)
+                    exp_value = exp_value * 10 + (str[i] - '0');
+                i++;
+            }
+            exponent += negative_exponent ? -exp_value : exp_value;
+        }
+
+        value = decimal_to_double(negative, mantissa, exponent, truncated,
+                                  str.data() + start_pos, i - start_pos);
+        return true;
+    }
+
+    /* expect(str, res)
+     *
+     * Expect that 'str' starts at the character that was just read. If it does, advance
+     * the input and return res. If not, flag an error.
+     */
+    Json expect(const string &expected, Json res) {
+        if (!expect(expected))
+            return Json();
+        return res;
+    }
+
+    bool expect(const string &expected) {
+        assert(i != 0);
+        i--;
+        if (str.compare(i, expected.length(), expected) == 0) {
+            i += expected.length();
+            return true;
+        } else {
+            return fail("parse error: expected " + expected + ", got " + str.substr(i, expected.length()), false);
+        }
+    }
+
+    /* make(value)
+     *
+     * Wrap a parsed string, array or object in a Json, in the arena if there is one.
+     */
+    template <typename T>
+    Json make(T &&value) {
+        return share(arena ? arena->make(std::forward<T>(value)) : Json(std::forward<T>(value)));
+    }
+
+    /* share(value)
+     *
+     * Return value or, if values are being deduplicated, the first equal one parsed.
+     */
+    Json share(Json &&value) {
+        return values ? values->canonical(move(value)) : move(value);
+    }
+
+    /* Container
+     *
+     * An array or object that parse_json() has opened and not yet closed: its elements, or
+     * its members so far, the last of which is waiting for its value.
+     */
+    struct Container {
+        bool is_object;
+        uint32_t previous_key; // see parse_key()
+        vector<Json> items;
+        ObjectEntries members;
+    };
+
+    /* open_member(container, ch)
+     *
+     * Parse the key of the next member of container and the ':' after it. ch is the character
+     * that should open the key. Return false on error.
+     */
+    bool open_member(Container &container, char ch) {
+        if (ch != '"')
+            return fail("expected '\"' in object, got " + esc(ch), false);
+
+        ObjectKey key = parse_key(container.previous_key);
+        if (failed)
+            return false;
+
+        ch = get_next_token();
+        if (ch != ':')
+            return fail("expected ':' in object, got " + esc(ch), false);
+        container.members.emplace_back(move(key), Json());
+        return true;
+    }
+
+    /* close(container)
+     *
+     * Build the Json for a complete container, and empty it for reuse. The result gets a
+     * vector of exactly the right size; the container keeps the capacity it grew to. Long
+     * enough arrays of numbers become a JsonNumberArray.
+     */
+    Json close(Container &container) {
+        if (container.is_object) {
+            sort_entries(container.members);
+            ObjectEntries data(std::make_move_iterator(container.members.begin()),
+                               std::make_move_iterator(container.members.end()));
+            container.members.clear();
+            return share(JsonArena::make_object(move(data),
+                                                keys ? std::shared_ptr<const void>(*keys) : nullptr,
+                                                object_index_threshold, arena));
+        }
+        if (number_array_threshold > 0 && container.items.size() >= number_array_threshold
+                && std::all_of(container.items.begin(), container.items.end(),
+                               [](const Json &item) { return item.is_number(); })) {
+            Json numbers = JsonArena::make_number_array(container.items, arena);
+            container.items.clear();
+            return share(move(numbers));
+        }
+        vector<Json> data(std::make_move_iterator(container.items.begin()),
+                          std::make_move_iterator(container.items.end()));
+        container.items.clear();
+        return make(move(data));
+    }
+
+    /* ParseStack
+     *
+     * The containers parse_json() has open. It lives outside the call so that a parse can be
+     * suspended partway through a value and resumed later (see JsonStreamParser).
+     */
+    struct ParseStack {
+        vector<Container> containers;
+        size_t depth = 0; // containers open; containers[depth] and above are idle
+    };
+
+    /* parse_json(max_depth)
+     *
+     * Parse a JSON value, with at most max_depth arrays and objects open around any value.
+     */
+    Json parse_json(size_t max_depth) {
+        ParseStack stack;
+        return parse_json(stack, max_depth, string::npos);
+    }
 
-            while (in_range(str[i], '0', '9'))
-                i++;
-        }
+    /* parse_json(stack, max_depth, stop_at)
+     *
+     * Parse a JSON value, continuing from whatever containers stack has open. Nesting is
+     * tracked there rather than by recursion, so the depth of the input doesn't bear on the
+     * depth of the native stack; the containers are reused for every array and object opened
+     * at the same depth. If the parse reaches offset stop_at where a value should begin, it
+     * returns early, leaving the containers open in stack; another call with the input from
+     * there on picks up where it left off.
+     */
+    Json parse_json(ParseStack &parse_stack, size_t max_depth, size_t stop_at) {
+        vector<Container> &stack = parse_stack.containers;
+        size_t depth = parse_stack.depth;
+        while (true) {
+            if (depth > max_depth)
+                return fail("exceeded maximum nesting depth");
+            if (i == stop_at) {
+                parse_stack.depth = depth;
+                return Json();
+            }
 
-        // Exponent part
-        if (str[i] == 'e' || str[i] == 'E') {
-            i++;
+            Json value;
+            char ch = get_next_token();
+            if (failed)
+                return Json();
 
-            if (str[i] == '+' || str[i] == '-')
-                i++;
+            if (ch == '-' || (ch >= '0' && ch <= '9')) {
+                i--;
+                value = parse_number();
+            } else if (ch == 't') {
+                value = expect("true", true);
+            } else if (ch == 'f') {
+                value = expect("false", false);
+            } else if (ch == 'n') {
+                value = expect("null", Json());
+            } else if (ch == '"') {
+                value = parse_string_value();
+            } else if (ch == '{' || ch == '[') {
+                const bool is_object = (ch == '{');
+                ch = get_next_token();
+                if (is_object && ch == '}') {
+                    value = share(JsonArena::make_object(ObjectEntries(), nullptr,
+                                                         object_index_threshold, arena));
+                } else if (!is_object && ch == ']') {
+                    value = make(vector<Json>());
+                } else {
+                    if (stack.size() == depth)
+                        stack.emplace_back();
+                    Container &container = stack[depth++];
+                    container.is_object = is_object;
+                    container.previous_key = 0;
+                    if (is_object && !open_member(container, ch))
+                        return Json();
+                    if (!is_object)
+                        i--;
+                    continue;
+                }
+            } else {
+                return fail("expected value, got " + esc(ch));
+            }
+            if (failed)
+                return Json();
 
-            if (!in_range(str[i], '0', '9'))
-                return fail("at least one digit required in exponent");
+            // Hand the value to the innermost open container, closing every container it
+            // completes, until one expects another value.
+            while (depth > 0) {
+                Container &container = stack[depth - 1];
+                if (container.is_object)
+                    container.members.back().second = move(value);
+                else
+                    container.items.push_back(move(value));
 
-            while (in_range(str[i], '0', '9'))
-                i++;
+                ch = get_next_token();
+                if (ch == (container.is_object ? '}' : ']')) {
+                    value = close(container);
+                    depth--;
+                    continue;
+                }
+                if (container.is_object) {
+                    if (ch != ',')
+                        return fail("expected ',' in object, got " + esc(ch));
+                    if (!open_member(container, get_next_token()))
+                        return Json();
+                } else {
+                    if (ch != ',')
+                        return fail("expected ',' in list, got " + esc(ch));
+                }
+                break;
+            }
+            if (depth == 0) {
+                parse_stack.depth = 0;
+                return value;
+            }
         }
-
-        return std::strtod(str.c_str() + start_pos, nullptr);
     }
 
-    /* expect(str, res)
+    /* parse_string_value()
      *
-     * Expect that 'str' starts at the character that was just read. If it does, advance
-     * the input and return res. If not, flag an error.
+     * Parse a string value, the opening quote having been read.
      */
-    Json expect(const string &expected, Json res) {
-        assert(i != 0);
-        i--;
-        if (str.compare(i, expected.length(), expected) == 0) {
-            i += expected.length();
-            return res;
-        } else {
-            return fail("parse error: expected " + expected + ", got " + str.substr(i, expected.length()));
+    Json parse_string_value() {
+        if (buffer) {
+            // A string with nothing to unescape, too long to be stored inline in a
+            // std::string, is referenced in place.
+            static const size_t inline_capacity = string().capacity();
+            const size_t end = find_string_special(str.data(), i, str.size());
+            if (end < str.size() && str[end] == '"' && end - i > inline_capacity) {
+                const size_t start = i;
+                i = end + 1;
+                return share(JsonArena::make_string_ref(*buffer, str.data() + start,
+                                                        end - start, arena));
+            }
         }
+        return make(parse_string());
     }
 
-    /* parse_json()
+    /* parse_events(depth, handler, scratch)
      *
-     * Parse a JSON object.
+     * Parse a JSON value like parse_json, but report it to handler instead of building a Json.
+     * String contents are decoded into scratch, which is reused for every string and key.
+     * Return false on error or if the handler asked to stop.
      */
-    Json parse_json(int depth) {
-        if (depth > max_depth) {
-            return fail("exceeded maximum nesting depth");
-        }
+    bool parse_events(size_t depth, JsonHandler &handler, string &scratch) {
+        if (depth > ParseOptions().max_depth)
+            return fail("exceeded maximum nesting depth", false);
 
         char ch = get_next_token();
         if (failed)
-            return Json();
+            return false;
 
         if (ch == '-' || (ch >= '0' && ch <= '9')) {
             i--;
-            return parse_number();
+            double value;
+            bool is_int;
+            if (!parse_number(value, is_int))
+                return false;
+            return handled(handler.on_number(value));
         }
 
         if (ch == 't')
-            return expect("true", true);
+            return expect("true") && handled(handler.on_bool(true));
 
         if (ch == 'f')
-            return expect("false", false);
+            return expect("false") && handled(handler.on_bool(false));
 
         if (ch == 'n')
-            return expect("null", Json());
+            return expect("null") && handled(handler.on_null());
 
         if (ch == '"')
-            return parse_string();
+            return parse_string(scratch) && handled(handler.on_string(scratch));
 
         if (ch == '{') {
-            map<string, Json> data;
+            if (!handled(handler.on_start_object()))
+                return false;
             ch = get_next_token();
             if (ch == '}')
-                return data;
+                return handled(handler.on_end_object());
 
             while (1) {
                 if (ch != '"')
-                    return fail("expected '\"' in object, got " + esc(ch));
+                    return fail("expected '\"' in object, got " + esc(ch), false);
 
-                string key = parse_string();
-                if (failed)
-                    return Json();
+                if (!parse_string(scratch) || !handled(handler.on_key(scratch)))
+                    return false;
 
                 ch = get_next_token();
                 if (ch != ':')
-                    return fail("expected ':' in object, got " + esc(ch));
+                    return fail("expected ':' in object, got " + esc(ch), false);
 
-                data[std::move(key)] = parse_json(depth + 1);
-                if (failed)
-                    return Json();
+                if (!parse_events(depth + 1, handler, scratch))
+                    return false;
 
                 ch = get_next_token();
                 if (ch == '}')
                     break;
                 if (ch != ',')
-                    return fail("expected ',' in object, got " + esc(ch));
+                    return fail("expected ',' in object, got " + esc(ch), false);
 
                 ch = get_next_token();
             }
-            return data;
+            return handled(handler.on_end_object());
         }
 
         if (ch == '[') {
-            vector<Json> data;
+            if (!handled(handler.on_start_array()))
+                return false;
             ch = get_next_token();
             if (ch == ']')
-                return data;
+                return handled(handler.on_end_array());
 
             while (1) {
                 i--;
-                data.push_back(parse_json(depth + 1));
-                if (failed)
-                    return Json();
+                if (!parse_events(depth + 1, handler, scratch))
+                    return false;
 
                 ch = get_next_token();
                 if (ch == ']')
                     break;
                 if (ch != ',')
-                    return fail("expected ',' in list, got " + esc(ch));
+                    return fail("expected ',' in list, got " + esc(ch), false);
 
                 ch = get_next_token();
                 (void)ch;
             }
-            return data;
+            return handled(handler.on_end_array());
         }
 
-        return fail("expected value, got " + esc(ch));
+        return fail("expected value, got " + esc(ch), false);
+    }
+
+    /* handled(keep_going)
+     *
+     * Check the result of a handler callback, flagging the parse as stopped if it returned false.
+     */
+    bool handled(bool keep_going) {
+        if (!keep_going)
+            return fail("parse stopped by handler", false);
+        return true;
     }
 };
 }//namespace {
 
 Json Json::parse(const string &in, string &err, JsonParse strategy) {
-    JsonParser parser { in, 0, err, false, strategy };
-    Json result = parser.parse_json(0);
+    ParseOptions options;
+    options.strategy = strategy;
+    return parse(in, err, options);
+}
+
+/* parse_with(text, err, options, arena, buffer)
+ *
+ * Json::parse, allocating the nodes of the result in arena if it is not null. buffer is
+ * either null or owns text.
+ */
+static Json parse_with(const string &text, string &err, const ParseOptions &options,
+                       JsonArena *arena, std::shared_ptr<const string> buffer) {
+    // Zero-copy strings need the input in a buffer they can share.
+    if (options.zero_copy_strings && !buffer)
+        buffer = make_shared<const string>(text);
+    const string &in = buffer ? *buffer : text;
+    const std::shared_ptr<KeyTable> keys = options.intern_keys ? make_shared<KeyTable>() : nullptr;
+    const std::unique_ptr<ValueTable> values(options.dedupe_values ? new ValueTable : nullptr);
+    JsonParser parser { in, 0, err, false, options.strategy, arena,
+                        options.object_index_threshold, options.number_array_threshold,
+                        options.zero_copy_strings ? &buffer : nullptr,
+                        options.intern_keys ? &keys : nullptr,
+                        values.get() };
+    Json result = parser.parse_json(options.max_depth);
 
     // Check for any trailing garbage
     parser.consume_garbage();
@@ -743,16 +3556,68 @@ Json Json::parse(const string &in, string &err, JsonParse strategy) {
     return result;
 }
 
+Json Json::parse(const string &in, string &err, const ParseOptions &options) {
+    return parse_with(in, err, options, nullptr, nullptr);
+}
+
+Json Json::parse(const std::shared_ptr<const string> &in, string &err,
+                 const ParseOptions &options) {
+    if (!in) {
+        err = "null input";
+        return nullptr;
+    }
+    return parse_with(*in, err, options, nullptr, in);
+}
+
+Json::Document::Document() : m_arena(new JsonArena) {}
+
+Json::Document::~Document() {
+    m_root = Json();
+    m_arena->release();
+}
+
+bool Json::Document::parse(const string &in, string &err, const ParseOptions &options) {
+    m_root = Json();
+    if (m_arena->in_use()) {
+        // Values from the last parse are still held elsewhere: leave the arena to them.
+        m_arena->release();
+        m_arena = new JsonArena;
+    } else {
+        m_arena->reset();
+    }
+    err.clear();
+    m_root = parse_with(in, err, options, m_arena, nullptr);
+    return err.empty();
+}
+
+// Documented in json11.hpp
+bool Json::sax_parse(const string &in, JsonHandler &handler, string &err, JsonParse strategy) {
+    JsonParser parser { in, 0, err, false, strategy, nullptr, 0, 0, nullptr, nullptr, nullptr };
+    string scratch;
+    if (!parser.parse_events(0, handler, scratch))
+        return false;
+
+    // Check for any trailing garbage
+    parser.consume_garbage();
+    if (parser.failed)
+        return false;
+    if (parser.i != in.size())
+        return parser.fail("unexpected trailing " + esc(in[parser.i]), false);
+
+    return true;
+}
+
 // Documented in json11.hpp
 vector<Json> Json::parse_multi(const string &in,
                                std::string::size_type &parser_stop_pos,
                                string &err,
                                JsonParse strategy) {
-    JsonParser parser { in, 0, err, false, strategy };
+    JsonParser parser { in, 0, err, false, strategy, nullptr, 0,
+                        ParseOptions().number_array_threshold, nullptr, nullptr, nullptr };
     parser_stop_pos = 0;
     vector<Json> json_vec;
     while (parser.i != in.size() && !parser.failed) {
-        json_vec.push_back(parser.parse_json(0));
+        json_vec.push_back(parser.parse_json(ParseOptions().max_depth));
         if (parser.failed)
             break;
 
@@ -765,21 +3630,496 @@ vector<Json> Json::parse_multi(const string &in,
     return json_vec;
 }
 
+/* * * * * * * * * * * * * * * * * * * *
+ * Pull parsing
+ */
+
+JsonReader::JsonReader(const string &in, JsonParse strategy)
+    : m_in(in), m_pos(0), m_failed(false), m_strategy(strategy), m_state(VALUE),
+      m_token(END), m_bool(false), m_number(0), m_is_int(false) {}
+
+JsonReader::Token JsonReader::next() {
+    if (m_failed)
+        return m_token = FAILED;
+
+    JsonParser parser { m_in, m_pos, m_err, false, m_strategy, nullptr, 0, 0,
+                        nullptr, nullptr, nullptr };
+    char ch = 0;
+    bool want_key = false, want_value = false, closed = false;
+
+    switch (m_state) {
+    case DONE:
+        // Check for any trailing garbage
+        parser.consume_garbage();
+        if (!parser.failed && parser.i != m_in.size())
+            parser.fail("unexpected trailing " + esc(m_in[parser.i]));
+        m_token = END;
+        break;
+    case VALUE:
+        ch = parser.get_next_token();
+        want_value = true;
+        break;
+    case ARRAY_FIRST:
+        ch = parser.get_next_token();
+        if (ch == ']')
+            closed = true;
+        else
+            want_value = true;
+        break;
+    case ARRAY_NEXT:
+        ch = parser.get_next_token();
+        if (ch == ']') {
+            closed = true;
+        } else if (ch == ',') {
+            ch = parser.get_next_token();
+            want_value = true;
+        } else {
+            parser.fail("expected ',' in list, got " + esc(ch));
+        }
+        break;
+    case OBJECT_FIRST_KEY:
+        ch = parser.get_next_token();
+        if (ch == '}')
+            closed = true;
+        else
+            want_key = true;
+        break;
+    case OBJECT_NEXT:
+        ch = parser.get_next_token();
+        if (ch == '}') {
+            closed = true;
+        } else if (ch == ',') {
+            ch = parser.get_next_token();
+            want_key = true;
+        } else {
+            parser.fail("expected ',' in object, got " + esc(ch));
+        }
+        break;
+    }
+
+    if (parser.failed) {
+        // Nothing more to do.
+    } else if (closed) {
+        m_token = (m_stack.back() == '{') ? END_OBJECT : END_ARRAY;
+        m_stack.pop_back();
+    } else if (want_key) {
+        if (ch != '"') {
+            parser.fail("expected '\"' in object, got " + esc(ch));
+        } else if (parser.parse_string(m_string)) {
+            ch = parser.get_next_token();
+            if (ch != ':')
+                parser.fail("expected ':' in object, got " + esc(ch));
+            m_token = KEY;
+            m_state = VALUE;
+        }
+    } else if (want_value) {
+        if (m_stack.size() > ParseOptions().max_depth) {
+            parser.fail("exceeded maximum nesting depth");
+        } else if (ch == '-' || (ch >= '0' && ch <= '9')) {
+            parser.i--;
+            parser.parse_number(m_number, m_is_int);
+            m_token = NUMBER;
+        } else if (ch == 't' || ch == 'f') {
+            m_bool = (ch == 't');
+            parser.expect(m_bool ? "true" : "false");
+            m_token = BOOL;
+        } else if (ch == 'n') {
+            parser.expect("null");
+            m_token = NUL;
+        } else if (ch == '"') {
+            parser.parse_string(m_string);
+            m_token = STRING;
+        } else if (ch == '{') {
+            m_stack.push_back('{');
+            m_token = START_OBJECT;
+            m_state = OBJECT_FIRST_KEY;
+        } else if (ch == '[') {
+            m_stack.push_back('[');
+            m_token = START_ARRAY;
+            m_state = ARRAY_FIRST;
+        } else {
+            parser.fail("expected value, got " + esc(ch));
+        }
+    }
+
+    // A value (or a whole container) just finished: work out what may follow it.
+    if (closed || (want_value && m_token != START_OBJECT && m_token != START_ARRAY)) {
+        if (m_stack.empty())
+            m_state = DONE;
+        else
+            m_state = (m_stack.back() == '{') ? OBJECT_NEXT : ARRAY_NEXT;
+    }
+
+    m_pos = parser.i;
+    if (parser.failed) {
+        m_failed = true;
+        m_token = FAILED;
+    }
+    return m_token;
+}
+
+int JsonReader::int_value() const {
+    // Converting an out-of-range double to int is undefined, so clamp first.
+    if (m_number >= static_cast<double>(std::numeric_limits<int>::max()))
+        return std::numeric_limits<int>::max();
+    if (m_number <= static_cast<double>(std::numeric_limits<int>::min()))
+        return std::numeric_limits<int>::min();
+    return static_cast<int>(m_number);
+}
+
+bool JsonReader::skip_value() {
+    if (m_token == KEY && next() == FAILED)
+        return false;
+
+    if (m_token == START_OBJECT || m_token == START_ARRAY) {
+        const size_t outer_depth = m_stack.size() - 1;
+        while (next() != FAILED) {
+            if (m_stack.size() == outer_depth && (m_token == END_OBJECT || m_token == END_ARRAY))
+                return true;
+        }
+    }
+    return !m_failed;
+}
+
+JsonReader::Token JsonReader::fail(string &&msg) {
+    if (!m_failed)
+        m_err = move(msg);
+    m_failed = true;
+    return m_token = FAILED;
+}
+
+bool JsonReader::expect(Token token, const char *what) {
+    if (next() == token)
+        return true;
+    fail(string("expected ") + what);
+    return false;
+}
+
+bool JsonReader::read_bool(bool &out) {
+    if (!expect(BOOL, "bool"))
+        return false;
+    out = m_bool;
+    return true;
+}
+
+bool JsonReader::read_number(double &out) {
+    if (!expect(NUMBER, "number"))
+        return false;
+    out = m_number;
+    return true;
+}
+
+bool JsonReader::read_string(string &out) {
+    if (!expect(STRING, "string"))
+        return false;
+    out = m_string;
+    return true;
+}
+
+Json JsonReader::read_value() {
+    return build(next());
+}
+
+Json JsonReader::build(Token token) {
+    switch (token) {
+    case NUL:
+        return Json();
+    case BOOL:
+        return m_bool;
+    case NUMBER:
+        // As Json::parse does, keep ints as ints.
+        if (m_is_int)
+            return static_cast<int>(m_number);
+        return m_number;
+    case STRING:
+        return m_string;
+    case START_ARRAY: {
+        Json::array items;
+        while (next() != END_ARRAY) {
+            Json item = build(m_token);
+            if (m_failed)
+                return Json();
+            items.push_back(move(item));
+        }
+        return items;
+    }
+    case START_OBJECT: {
+        ObjectEntries items;
+        while (next() == KEY) {
+            ObjectKey key(m_string.data(), m_string.size());
+            Json value = build(next());
+            if (m_failed)
+                return Json();
+            items.emplace_back(move(key), move(value));
+        }
+        if (m_failed)
+            return Json();
+        sort_entries(items);
+        return JsonArena::make_object(move(items), nullptr, 0, nullptr);
+    }
+    case FAILED:
+        return Json();
+    default:
+        fail("expected value");
+        return Json();
+    }
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Incremental parsing
+ */
+
+struct JsonStreamParser::Pending {
+    JsonParser::ParseStack stack;
+};
+
+JsonStreamParser::JsonStreamParser(JsonParse strategy)
+    : m_strategy(strategy), m_state(BETWEEN), m_safe(0), m_pending(new Pending),
+      m_ready_pos(0), m_failed(false) {}
+
+JsonStreamParser::~JsonStreamParser() {}
+
+/* in_value()
+ *
+ * Whether the scanner is partway through a value, as opposed to between values (possibly
+ * inside a comment that separates them).
+ */
+bool JsonStreamParser::in_value() const {
+    switch (m_state) {
+    case BETWEEN:
+        return false;
+    case SLASH: case LINE_COMMENT: case BLOCK_COMMENT: case BLOCK_COMMENT_STAR:
+        return !m_open.empty();
+    default:
+        return true;
+    }
+}
+
+/* advance(stop_at, value)
+ *
+ * Run the parser over m_buf, carrying on with the containers it left open last time, until
+ * the value is complete (it is then stored in value) or offset stop_at is reached where an
+ * element or member value should begin. Drop the input it consumed from m_buf. Return false
+ * on error.
+ */
+bool JsonStreamParser::advance(size_t stop_at, Json &value) {
+    const ParseOptions options;
+    JsonParser parser { m_buf, 0, m_err, false, m_strategy, nullptr,
+                        options.object_index_threshold, options.number_array_threshold,
+                        nullptr, nullptr, nullptr };
+    value = parser.parse_json(m_pending->stack, options.max_depth, stop_at);
+    if (!parser.failed && stop_at == string::npos) {
+        parser.consume_garbage();
+        if (!parser.failed && parser.i != m_buf.size())
+            parser.fail("unexpected trailing " + esc(m_buf[parser.i]));
+    }
+    if (parser.failed) {
+        m_failed = true;
+        return false;
+    }
+    m_buf.erase(0, parser.i);
+    return true;
+}
+
+/* complete()
+ *
+ * Finish parsing the value in progress, the scanner having just seen the end of it.
+ */
+void JsonStreamParser::complete() {
+    Json value;
+    if (!advance(string::npos, value))
+        return;
+    m_ready.push_back(move(value));
+    m_buf.clear();
+    m_safe = 0;
+    m_state = BETWEEN;
+}
+
+void JsonStreamParser::fail(string &&msg) {
+    if (!m_failed)
+        m_err = move(msg);
+    m_failed = true;
+}
+
+static inline bool is_scalar_delimiter(char ch) {
+    switch (ch) {
+    case ' ': case '\r': case '\n': case '\t':
+    case '{': case '}': case '[': case ']': case ',': case ':': case '"': case '/':
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool JsonStreamParser::feed(const char *data, size_t len) {
+    if (m_failed)
+        return false;
+
+    const bool comments = (m_strategy == JsonParse::COMMENTS);
+    // Start of the part of this chunk that belongs to the value in progress, if any.
+    size_t start = in_value() ? 0 : len;
+
+    for (size_t k = 0; k < len && !m_failed; k++) {
+        const char ch = data[k];
+        switch (m_state) {
+        case BETWEEN:
+            if (ch == ' ' || ch == '\r' || ch == '\n' || ch == '\t')
+                break;
+            if (comments && ch == '/') {
+                m_state = SLASH;
+                break;
+            }
+            start = k;
+            if (ch == '{' || ch == '[') {
+                m_open.assign(1, ch);
+                m_state = IN_CONTAINER;
+            } else if (ch == '"') {
+                m_state = IN_STRING;
+            } else {
+                m_state = IN_SCALAR;
+            }
+            break;
+
+        case IN_CONTAINER:
+            if (ch == '"') {
+                m_state = IN_STRING;
+            } else if (ch == '{' || ch == '[') {
+                m_open.push_back(ch);
+            } else if (ch == '}' || ch == ']') {
+                m_open.pop_back();
+                if (m_open.empty()) {
+                    m_buf.append(data + start, k + 1 - start);
+                    start = len;
+                    complete();
+                }
+            } else if (ch == ':' || (ch == ',' && m_open.back() == '[')) {
+                // A member or element value starts next: the parser can stop here.
+                m_safe = m_buf.size() + (k + 1 - start);
+            } else if (comments && ch == '/') {
+                m_state = SLASH;
+            }
+            break;
+
+        case IN_STRING:
+            if (ch == '\\') {
+                m_state = IN_ESCAPE;
+            } else if (ch == '"') {
+                if (!m_open.empty()) {
+                    m_state = IN_CONTAINER;
+                } else {
+                    m_buf.append(data + start, k + 1 - start);
+                    start = len;
+                    complete();
+                }
+            }
+            break;
+
+        case IN_ESCAPE:
+            m_state = IN_STRING;
+            break;
+
+        case IN_SCALAR:
+            // A top-level number or literal ends at the first character that can't be part of
+            // it; that character is then scanned again as the start of whatever follows.
+            if (is_scalar_delimiter(ch)) {
+                m_buf.append(data + start, k - start);
+                start = len;
+                complete();
+                k--;
+            }
+            break;
+
+        case SLASH:
+            if (ch == '/') {
+                m_state = LINE_COMMENT;
+            } else if (ch == '*') {
+                m_state = BLOCK_COMMENT;
+            } else if (m_open.empty()) {
+                fail("malformed comment");
+            } else {
+                // Leave the error for the parser to report once the value is complete.
+                m_state = IN_CONTAINER;
+                k--;
+            }
+            break;
+
+        case LINE_COMMENT:
+            if (ch == '\n')
+                m_state = m_open.empty() ? BETWEEN : IN_CONTAINER;
+            break;
+
+        case BLOCK_COMMENT:
+            if (ch == '*')
+                m_state = BLOCK_COMMENT_STAR;
+            break;
+
+        case BLOCK_COMMENT_STAR:
+            if (ch == '/')
+                m_state = m_open.empty() ? BETWEEN : IN_CONTAINER;
+            else if (ch != '*')
+                m_state = BLOCK_COMMENT;
+            break;
+        }
+    }
+
+    if (!m_failed && start < len)
+        m_buf.append(data + start, len - start);
+
+    // Parse as much of the value in progress as can be, so only the rest need be kept.
+    if (!m_failed && m_safe > 0) {
+        Json unused;
+        advance(m_safe, unused);
+        m_safe = 0;
+    }
+    return !m_failed;
+}
+
+bool JsonStreamParser::finish() {
+    if (m_failed)
+        return false;
+
+    if (m_state == IN_SCALAR) {
+        complete();
+    } else if (m_state == SLASH && m_open.empty()) {
+        fail("unexpected end of input after start of comment");
+    } else if (m_state == BLOCK_COMMENT || m_state == BLOCK_COMMENT_STAR) {
+        fail("unexpected end of input inside multi-line comment");
+    } else if (in_value()) {
+        fail("unexpected end of input");
+    }
+    return !m_failed;
+}
+
+bool JsonStreamParser::next(Json &out) {
+    if (m_ready_pos == m_ready.size())
+        return false;
+
+    out = move(m_ready[m_ready_pos++]);
+    if (m_ready_pos == m_ready.size()) {
+        m_ready.clear();
+        m_ready_pos = 0;
+    }
+    return true;
+}
+
 /* * * * * * * * * * * * * * * * * * * *
  * Shape-checking
  */
 
-bool Json::has_shape(const shape & types, string & err) const {
-    if (!is_object()) {
-        err = "expected JSON object, got " + dump();
+// Check object (null if json isn't one) for the fields in [begin, end), for has_shape().
+template <typename Item>
+static bool check_shape(const Json &json, const JsonObject *object, const Item *begin,
+                        const Item *end, string &err) {
+    if (!object) {
+        err = "expected JSON object, got " + json.dump();
         return false;
     }
 
-    const auto& obj_items = object_items();
-    for (auto & item : types) {
-        const auto it = obj_items.find(item.first);
-        if (it == obj_items.cend() || it->second.type() != item.second) {
-            err = "bad type for " + item.first + " in " + dump();
+    for (const Item *item = begin; item != end; ++item) {
+        const Json::string_ref key(item->first);
+        const Json *value = object->find(key);
+        if (!value || value->type() != item->second) {
+            err = "bad type for " + key.str() + " in " + json.dump();
             return false;
         }
     }
@@ -787,4 +4127,70 @@ bool Json::has_shape(const shape & types, string & err) const {
     return true;
 }
 
+bool Json::has_shape(const shape & types, string & err) const {
+    const JsonObject *object = is_object() ? static_cast<const JsonObject *>(node())
+                                           : nullptr;
+    return check_shape(*this, object, types.begin(), types.end(), err);
+}
+
+bool Json::has_shape(const std::pair<string_ref, Type> *types, size_t count,
+                     string &err) const {
+    const JsonObject *object = is_object() ? static_cast<const JsonObject *>(node())
+                                           : nullptr;
+    return check_shape(*this, object, types, types + count, err);
+}
+
+/* * * * * * * * * * * * * * * * * * * *
+ * Deferred freeing
+ */
+
+struct JsonFreeQueue::State {
+    std::mutex mutex;
+    std::condition_variable queued;
+    vector<Json> values;
+    bool closed = false;
+};
+
+JsonFreeQueue::JsonFreeQueue() : m_state(new State) {}
+
+JsonFreeQueue::~JsonFreeQueue() {}
+
+void JsonFreeQueue::push(Json &&value) {
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->values.push_back(move(value));
+    }
+    m_state->queued.notify_one();
+}
+
+size_t JsonFreeQueue::drain() {
+    vector<Json> values;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        values.swap(m_state->values);
+    }
+    // Freed here, outside the lock, so that push() never waits for it.
+    return values.size();
+}
+
+bool JsonFreeQueue::wait_and_drain() {
+    vector<Json> values;
+    {
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+        m_state->queued.wait(lock, [this] { return m_state->closed || !m_state->values.empty(); });
+        if (m_state->values.empty())
+            return false;
+        values.swap(m_state->values);
+    }
+    return true;
+}
+
+void JsonFreeQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->closed = true;
+    }
+    m_state->queued.notify_all();
+}
+
 } // namespace json11
@@ -55,6 +55,12 @@
 #include <map>
 #include <memory>
 #include <initializer_list>
+#include <utility>
+#include <atomic>
+#include <cstdint>
+#ifdef __GLIBCXX__
+#include <ext/atomicity.h>
+#endif
 
 #ifdef _MSC_VER
     #if _MSC_VER <= 1800 // VS 2013
@@ -68,13 +74,95 @@
     #endif
 #endif
 
+/* JSON11_SINGLE_THREADED
+ *
+ * Strings, arrays and objects are reference counted, so that copies of a Json share them. By
+ * default the counts are atomic, and copies may be used from any number of threads. Define
+ * JSON11_SINGLE_THREADED to 1 (the CMake option of the same name does) for programs that never
+ * hand a Json, or anything copied from one, to another thread: the counts are then updated
+ * with plain arithmetic, which makes copying and releasing values considerably cheaper. It must
+ * be defined the same way for json11.cpp and for everything that includes this header.
+ */
+#ifndef JSON11_SINGLE_THREADED
+#define JSON11_SINGLE_THREADED 0
+#endif
+
 namespace json11 {
 
 enum JsonParse {
     STANDARD, COMMENTS
 };
 
+/* ParseOptions
+ *
+ * Settings for Json::parse beyond the JsonParse strategy. The defaults match parse(in, err).
+ */
+struct ParseOptions {
+    JsonParse strategy = JsonParse::STANDARD;
+
+    // Objects with at least this many members also get an open-addressing hash index, so
+    // operator[] finds a key in O(1) instead of by binary search. Meant for wide lookup tables;
+    // it costs an extra 8 to 16 bytes per member. 0 (the default) never builds the index.
+    // dump() and iteration order are not affected.
+    size_t object_index_threshold = 0;
+
+    // Arrays of at least this many elements that are all numbers are stored as contiguous
+    // doubles, 8 bytes each instead of a 16-byte Json, and can be read in place through
+    // number_span_value(). array_items() on one builds a full Json::array copy of it the
+    // first time, and keeps it alongside; operator[] and visit() do not. 0 stores every array
+    // as a Json::array.
+    size_t number_array_threshold = 16;
+
+    // Keep strings that contain no escapes as views into the input instead of copying each
+    // one. Every view shares ownership of the input, which stays alive for as long as any of
+    // them does: pass it to parse() as a shared_ptr to avoid copying it, or it is copied once.
+    // Strings short enough for std::string's inline storage are still copied, as that needs
+    // no allocation. string_value() on a view builds its std::string on first use;
+    // string_ref_value() never does. Object keys are always copied.
+    bool zero_copy_strings = false;
+
+    // Store each distinct long object key once per parse, and have every object that uses it
+    // refer to that copy instead of allocating its own. Suits arrays of records, where the
+    // same keys repeat in every element. Keys of up to 24 bytes are stored inline in each
+    // object either way, without an allocation. Interned keys are held until the last object
+    // of the parse is released.
+    bool intern_keys = false;
+
+    // Share a single node between equal strings, arrays and objects, as Json::dedupe() does,
+    // as they are parsed, so that repeated values are only held once. Costs a hash of each.
+    bool dedupe_values = false;
+
+    // The most arrays and objects that may be open around a value; deeper input fails to
+    // parse. The parser keeps its own stack, so this only bounds its memory, not the native
+    // stack. Other operations on a tree (such as dump() and comparisons) still recurse one
+    // level per array or object, so very deep trees want a large thread stack.
+    size_t max_depth = 200;
+};
+
 class JsonValue;
+class JsonArena;
+class ValueTable;
+
+/* JsonHandler
+ *
+ * Receives the events produced by Json::sax_parse, in document order, without any Json values
+ * being built. Each callback returns true to continue parsing or false to stop; the default
+ * implementations ignore the event. The strings passed to on_string() and on_key() are only
+ * valid for the duration of the call.
+ */
+class JsonHandler {
+public:
+    virtual ~JsonHandler() {}
+    virtual bool on_null()                        { return true; }
+    virtual bool on_bool(bool)                    { return true; }
+    virtual bool on_number(double)                { return true; }
+    virtual bool on_string(const std::string &)   { return true; }
+    virtual bool on_start_object()                { return true; }
+    virtual bool on_key(const std::string &)      { return true; }
+    virtual bool on_end_object()                  { return true; }
+    virtual bool on_start_array()                 { return true; }
+    virtual bool on_end_array()                   { return true; }
+};
 
 class Json final {
 public:
@@ -87,12 +175,66 @@ public:
     typedef std::vector<Json> array;
     typedef std::map<std::string, Json> object;
 
-    // Constructors for the various types of JSON value.
+    // A parsed tree whose nodes share one arena; see below.
+    class Document;
+
+    // A read-only view of the characters of a string. It doesn't own them: a string_ref made
+    // from a std::string or C string is only valid while that string is.
+    struct string_ref {
+        const char * data;
+        size_t size;
+
+        string_ref() : data(""), size(0) {}
+        string_ref(const char * s, size_t n) : data(s), size(n) {}
+        string_ref(const char * s) : data(s), size(std::char_traits<char>::length(s)) {}
+        string_ref(const std::string & s) : data(s.data()), size(s.size()) {}
+
+        std::string str() const { return std::string(data, size); }
+    };
+
+    // A read-only view of the numbers of an array, valid for as long as the array (or a copy
+    // of it) is.
+    struct number_span {
+        const double * data;
+        size_t size;
+
+        number_span() : data(nullptr), size(0) {}
+        number_span(const double * d, size_t n) : data(d), size(n) {}
+
+        const double * begin() const { return data; }
+        const double * end() const { return data + size; }
+        double operator[](size_t i) const { return data[i]; }
+    };
+
+    // A read-only view of the members of an object, in key order, that doesn't build the
+    // std::map object_items() returns. It is valid for as long as the object (or a copy of it)
+    // is.
+    class object_ref {
+    public:
+        object_ref() : m_entries(nullptr), m_values(nullptr), m_size(0), m_stride(0) {}
+
+        size_t size() const { return m_size; }
+        string_ref key(size_t i) const;
+        const Json & value(size_t i) const {
+            return *reinterpret_cast<const Json *>(m_values + i * m_stride);
+        }
+
+    private:
+        friend class Json;
+        const void * m_entries;
+        const char * m_values;
+        size_t m_size;
+        size_t m_stride;
+    };
+
+    // Constructors for the various types of JSON value. Null, booleans and numbers are held
+    // inline, with no allocation or reference count, so any number of threads can create,
+    // copy and drop them without writing to shared memory.
     Json() noexcept;                // NUL
     Json(std::nullptr_t) noexcept;  // NUL
-    Json(double value);             // NUMBER
-    Json(int value);                // NUMBER
-    Json(bool value);               // BOOL
+    Json(double value) noexcept;    // NUMBER
+    Json(int value) noexcept;       // NUMBER
+    Json(bool value) noexcept;      // BOOL
     Json(const std::string &value); // STRING
     Json(std::string &&value);      // STRING
     Json(const char * value);       // STRING
@@ -122,8 +264,19 @@ public:
     // Json(bool(some_pointer)) if that behavior is desired.
     Json(void *) = delete;
 
-    // Accessors
-    Type type() const;
+    // Copies share the payload of strings, arrays and objects, which is immutable. A moved-from
+    // Json is null.
+    Json(const Json &other) noexcept;
+    Json &operator=(const Json &other) noexcept;
+    Json(Json &&other) noexcept : m_tag(other.m_tag), m_value(other.m_value) {
+        other.m_tag = NUL;
+    }
+    Json &operator=(Json &&other) noexcept;
+    ~Json();
+
+    // Accessors. Those of null, booleans and numbers only read the Json itself, so they are
+    // defined here, to be inlined into the caller's loops.
+    Type type() const { return m_tag == INT_NUMBER ? NUMBER : static_cast<Type>(m_tag); }
 
     bool is_null()   const { return type() == NUL; }
     bool is_number() const { return type() == NUMBER; }
@@ -135,22 +288,92 @@ public:
     // Return the enclosed value if this is a number, 0 otherwise. Note that json11 does not
     // distinguish between integer and non-integer numbers - number_value() and int_value()
     // can both be applied to a NUMBER-typed object.
-    double number_value() const;
-    int int_value() const;
+    double number_value() const {
+        if (m_tag == INT_NUMBER)
+            return m_value.i;
+        return m_tag == NUMBER ? m_value.d : 0;
+    }
+    int int_value() const {
+        if (m_tag == INT_NUMBER)
+            return m_value.i;
+        return m_tag == NUMBER ? static_cast<int>(m_value.d) : 0;
+    }
 
     // Return the enclosed value if this is a boolean, false otherwise.
-    bool bool_value() const;
+    bool bool_value() const { return m_tag == BOOL && m_value.b; }
     // Return the enclosed string if this is a string, "" otherwise.
     const std::string &string_value() const;
-    // Return the enclosed std::vector if this is an array, or an empty vector otherwise.
+    // Return the characters of the enclosed string if this is a string, an empty view
+    // otherwise. Unlike string_value(), this never copies a zero-copy string. The view is
+    // valid for as long as this Json (or a copy of it) is.
+    string_ref string_ref_value() const;
+    // Return the enclosed std::vector if this is an array, or an empty vector otherwise. An
+    // array stored as contiguous doubles (see ParseOptions::number_array_threshold) has none:
+    // the first call builds a copy of it, 16 bytes an element, and keeps it with the array, so
+    // prefer number_span_value() or operator[] for reading parsed input.
     const array &array_items() const;
-    // Return the enclosed std::map if this is an object, or an empty map otherwise.
+    // Return the enclosed std::map if this is an object, or an empty map otherwise. A parsed
+    // object is stored without one: it is built on the first call and kept with the object, so
+    // prefer operator[] or object_ref_value() for reading parsed input.
     const object &object_items() const;
+    // Return the members if this is an object, or an empty view otherwise.
+    object_ref object_ref_value() const;
+    // Return the numbers if this is an array stored as contiguous doubles (see
+    // ParseOptions::number_array_threshold), or an empty view otherwise, including for arrays
+    // of numbers stored as a Json::array.
+    number_span number_span_value() const;
 
-    // Return a reference to arr[i] if this is an array, Json() otherwise.
+    // Return a reference to arr[i] if this is an array, Json() otherwise. For an array stored
+    // as contiguous doubles, this builds only the few elements around i.
     const Json & operator[](size_t i) const;
-    // Return a reference to obj[key] if this is an object, Json() otherwise.
-    const Json & operator[](const std::string &key) const;
+    // Return a reference to obj[key] if this is an object, Json() otherwise. None of these
+    // overloads copies the key.
+    const Json & operator[](string_ref key) const;
+    const Json & operator[](const std::string &key) const { return (*this)[string_ref(key)]; }
+    // C strings (a template, so that obj[0] still means the first array element).
+    template <class T, typename std::enable_if<
+        std::is_same<T, const char *>::value || std::is_same<T, char *>::value,
+            int>::type = 0>
+    const Json & operator[](T key) const { return (*this)[string_ref(key)]; }
+    // A prepared key, for fields read again and again; see Json::Key.
+    class Key;
+    const Json & operator[](const Key &key) const;
+
+    // Call f with the value this holds, as its own type, and return what f returns:
+    //
+    //     f(nullptr)                  null
+    //     f(bool)                     booleans
+    //     f(int)                      numbers constructed from an int, or parsed without a
+    //                                 fraction or exponent and within the range of an int
+    //     f(double)                   other numbers
+    //     f(string_ref)               strings; zero-copy ones are not copied
+    //     f(number_span)              arrays stored as contiguous doubles, if f accepts a
+    //                                 number_span; otherwise they are passed to
+    //     f(const array &)            arrays, building array_items() for contiguous numbers
+    //     f(object_ref)               objects, without building object_items()
+    //
+    // f must handle every one of these but number_span, returning the same type. It is called
+    // once, with one test of the type, so a traversal (hashing, size accounting, conversion)
+    // recurses by having f call visit() on the elements and member values.
+    template <typename F>
+    auto visit(F && f) const -> decltype(f(nullptr)) {
+        switch (m_tag) {
+        case INT_NUMBER:
+            return f(m_value.i);
+        case NUMBER:
+            return f(m_value.d);
+        case BOOL:
+            return f(m_value.b);
+        case STRING:
+            return f(string_ref_value());
+        case ARRAY:
+            return visit_array(f, 0);
+        case OBJECT:
+            return f(object_ref_value());
+        default:
+            return f(nullptr);
+        }
+    }
 
     // Serialize.
     void dump(std::string &out) const;
@@ -174,6 +397,13 @@ public:
             return nullptr;
         }
     }
+    static Json parse(const std::string & in,
+                      std::string & err,
+                      const ParseOptions & options);
+    // As above, sharing ownership of in with any zero-copy strings instead of copying it.
+    static Json parse(const std::shared_ptr<const std::string> & in,
+                      std::string & err,
+                      const ParseOptions & options);
     // Parse multiple objects, concatenated or separated by whitespace
     static std::vector<Json> parse_multi(
         const std::string & in,
@@ -189,6 +419,17 @@ public:
         return parse_multi(in, parser_stop_pos, err, strategy);
     }
 
+    /* sax_parse(in, handler, err)
+     *
+     * Parse in, reporting each value to handler instead of building a Json. Return true if the
+     * whole input is valid. On a syntax error, or if a callback returns false, return false and
+     * assign an error message to err.
+     */
+    static bool sax_parse(const std::string & in,
+                          JsonHandler & handler,
+                          std::string & err,
+                          JsonParse strategy = JsonParse::STANDARD);
+
     bool operator== (const Json &rhs) const;
     bool operator<  (const Json &rhs) const;
     bool operator!= (const Json &rhs) const { return !(*this == rhs); }
@@ -204,29 +445,415 @@ public:
     typedef std::initializer_list<std::pair<std::string, Type>> shape;
     bool has_shape(const shape & types, std::string & err) const;
 
+    // The same check against an array of string_ref keys, which aren't copied: a shape that is
+    // checked often can be kept in a static array.
+    //
+    //     static const std::pair<Json::string_ref, Json::Type> fields[] = {
+    //         { "id", Json::NUMBER }, { "name", Json::STRING } };
+    //     if (!request.has_shape(fields, err)) ...
+    template <size_t N>
+    bool has_shape(const std::pair<string_ref, Type> (& types)[N], std::string & err) const {
+        return has_shape(types, N, err);
+    }
+    bool has_shape(const std::pair<string_ref, Type> * types, size_t count,
+                   std::string & err) const;
+
+    /* dedupe()
+     *
+     * Return a copy of this value in which equal strings, arrays and objects share a single
+     * node. Json values are immutable, so sharing is invisible to readers; it only saves the
+     * memory of the repeats, e.g. the identical sub-objects of a config snapshot. Takes time
+     * linear in the size of the value. See also ParseOptions::dedupe_values.
+     */
+    Json dedupe() const;
+
 private:
-    std::shared_ptr<JsonValue> m_ptr;
+    friend class JsonArena;
+    friend class JsonValue;
+    friend class ValueTable;
+    Json(Type type, JsonValue * node) noexcept; // takes over node's initial reference
+
+    // The ARRAY case of visit(): the first overload is chosen if f accepts a number_span.
+    template <typename F>
+    auto visit_array(F & f, int) const -> decltype(f(number_span())) {
+        const number_span numbers = number_span_value();
+        return numbers.size ? f(numbers) : f(array_items());
+    }
+    template <typename F>
+    auto visit_array(F & f, long) const -> decltype(f(std::declval<const array &>())) {
+        return f(array_items());
+    }
+
+    // m_tag is the Type held, or INT_NUMBER for a NUMBER held in m_value.i rather than
+    // m_value.d. Null, booleans and numbers are held inline; strings, arrays and objects are
+    // allocated, and m_value.node holds a reference to the node, which holds its own count
+    // (see JsonValue).
+    enum : uint8_t { INT_NUMBER = OBJECT + 1 };
+    bool has_node() const { return m_tag >= STRING && m_tag <= OBJECT; }
+    JsonValue * node() const { return m_value.node; }
+
+    uint8_t m_tag;
+    union {
+        double d;
+        int i;
+        bool b;
+        JsonValue * node;
+    } m_value;
+};
+
+// Every array element and object value is a Json, so keep it to a tag and one 8-byte payload.
+static_assert(sizeof(Json) <= 16, "Json has grown past a tag and a payload");
+
+/* Json::Key
+ *
+ * An object key prepared for repeated lookups, such as the same few fields read from every
+ * message of a stream:
+ *
+ *     static const Json::Key user_id("user_id");
+ *     for (const Json &message : messages)
+ *         handle(message[user_id]);
+ *
+ * It carries a copy of the key, its hash, so that hash-indexed objects don't rehash it, and
+ * the position the key was last found at. Objects with the same layout are then usually
+ * answered by a single compare at that position, without searching. A Key may be shared
+ * between threads.
+ */
+class Json::Key final {
+public:
+    explicit Key(std::string name);
+    Key(const Key &other);
+    Key & operator=(const Key &) = delete;
+
+    const std::string & name() const { return m_name; }
+
+private:
+    friend class JsonObject;
+    const std::string m_name;
+    const uint64_t m_hash;
+    mutable std::atomic<uint32_t> m_hint;
 };
 
-// Internal class hierarchy - JsonValue objects are not exposed to users of this API.
+/* Json::Document
+ *
+ * Owns one parsed tree and the arena its nodes live in. Every string, array and object node
+ * (together with its reference count) is bump-allocated from a few large blocks instead of
+ * with one heap allocation each, and the blocks are released together. That suits
+ * request-scoped JSON that is parsed, read and dropped:
+ *
+ *     Json::Document doc;
+ *     if (doc.parse(body, err))
+ *         handle(doc.root());
+ *
+ * The contents of strings, arrays and objects (their std::string and std::vector storage)
+ * still come from the normal allocator, and are freed by the nodes' destructors when the tree
+ * is released. Json values taken from root() may outlive the document and its next parse():
+ * each node keeps the arena alive, and the arena's blocks are freed once the document and the
+ * last such value are gone. A next parse() reuses the arena only if nothing from the previous
+ * one is still held, and otherwise starts a new one.
+ */
+class Json::Document final {
+public:
+    Document();
+    ~Document();
+    Document(const Document &) = delete;
+    Document & operator=(const Document &) = delete;
+
+    // Parse in, replacing the previous root. The arena keeps its largest block from the
+    // previous parse for reuse. If parse fails, root() is null and err holds the message.
+    bool parse(const std::string & in,
+               std::string & err,
+               const ParseOptions & options = ParseOptions());
+
+    const Json & root() const { return m_root; }
+
+private:
+    JsonArena * m_arena; // shared with the nodes allocated in it, see JsonArena
+    Json m_root;
+};
+
+/* JsonReader
+ *
+ * Pull parser: a cursor that walks the input one token at a time, so callers can stream through
+ * large documents without building them and stop as soon as they have what they need. The
+ * input string must outlive the reader.
+ *
+ *     JsonReader reader(in);
+ *     if (reader.next() == JsonReader::START_OBJECT) {
+ *         while (reader.next() == JsonReader::KEY) {
+ *             if (reader.string_value() == "id") {
+ *                 double id;
+ *                 reader.read_number(id);
+ *             } else {
+ *                 reader.skip_value();
+ *             }
+ *         }
+ *     }
+ *
+ * Once an error is seen every call returns FAILED (or false) and error() describes it.
+ */
+class JsonReader final {
+public:
+    enum Token {
+        END, FAILED, NUL, BOOL, NUMBER, STRING, KEY,
+        START_OBJECT, END_OBJECT, START_ARRAY, END_ARRAY
+    };
+
+    explicit JsonReader(const std::string & in, JsonParse strategy = JsonParse::STANDARD);
+    // The reader keeps a reference to its input, so it can't be given a temporary.
+    JsonReader(std::string && in, JsonParse strategy = JsonParse::STANDARD) = delete;
+
+    // Advance to the next token and return it. END is returned once the top-level value and
+    // any trailing whitespace have been consumed.
+    Token next();
+
+    // Skip the value belonging to the current token: the rest of the container after
+    // START_OBJECT or START_ARRAY, or the whole value after KEY. Scalars are already complete,
+    // so this is a no-op for them. Return false on error.
+    bool skip_value();
+
+    // Read the next value, which must be of the given type. Return false (and flag an error)
+    // if it is not.
+    bool read_bool(bool & out);
+    bool read_number(double & out);
+    bool read_string(std::string & out);
+
+    // Read the next value, including any nested containers, as a Json.
+    Json read_value();
+
+    // The current token and its value. string_value() holds the text of a STRING or KEY.
+    Token token() const                      { return m_token; }
+    bool bool_value() const                  { return m_bool; }
+    double number_value() const              { return m_number; }
+    // The number truncated to an int, saturating at the limits of int when out of range.
+    int int_value() const;
+    const std::string & string_value() const { return m_string; }
+
+    // Number of containers enclosing the current position.
+    size_t depth() const                     { return m_stack.size(); }
+    // Offset of the next unread character in the input.
+    size_t offset() const                    { return m_pos; }
+    const std::string & error() const        { return m_err; }
+
+private:
+    enum State {
+        VALUE, DONE, OBJECT_FIRST_KEY, OBJECT_NEXT, ARRAY_FIRST, ARRAY_NEXT
+    };
+
+    Token fail(std::string && msg);
+    bool expect(Token token, const char * what);
+    Json build(Token token);
+
+    const std::string & m_in;
+    size_t m_pos;
+    std::string m_err;
+    bool m_failed;
+    const JsonParse m_strategy;
+    State m_state;
+    std::vector<char> m_stack;
+    Token m_token;
+    bool m_bool;
+    double m_number;
+    bool m_is_int; // m_number was written without a fraction or exponent and fits an int
+    std::string m_string;
+};
+
+/* JsonStreamParser
+ *
+ * Incremental parser for a stream of JSON values (concatenated or separated by whitespace, as
+ * in parse_multi) that arrives in arbitrary chunks, e.g. from a socket. A light scanner tracks
+ * strings, comments and nesting across chunks to find where each value ends and where it is
+ * safe to parse up to. At the end of every chunk the parser is run as far as the last such
+ * point, after a ':' or after a ',' in an array, and the arrays and objects it has open are
+ * kept for the next chunk. So a large value is parsed as it arrives, and only the bytes since
+ * the last safe point (at most one member or element plus the input after it) are retained.
+ *
+ *     JsonStreamParser stream;
+ *     while (read_frame(buf, len)) {
+ *         if (!stream.feed(buf, len))
+ *             break;                      // stream.error() says why
+ *         Json value;
+ *         while (stream.next(value))
+ *             handle(value);
+ *     }
+ */
+class JsonStreamParser final {
+public:
+    explicit JsonStreamParser(JsonParse strategy = JsonParse::STANDARD);
+    ~JsonStreamParser();
+    JsonStreamParser(const JsonStreamParser &) = delete;
+    JsonStreamParser & operator=(const JsonStreamParser &) = delete;
+
+    // Append a chunk of input. Return false once the stream has failed.
+    bool feed(const char * data, size_t len);
+    bool feed(const std::string & data) { return feed(data.data(), data.size()); }
+
+    // Signal the end of the input. This completes a trailing top-level number, which can't be
+    // known to be finished until then, and fails if a value is left incomplete.
+    bool finish();
+
+    // Pop the next complete value. Return false if none is ready.
+    bool next(Json & out);
+
+    bool failed() const                  { return m_failed; }
+    const std::string & error() const    { return m_err; }
+
+private:
+    enum State {
+        BETWEEN, IN_CONTAINER, IN_STRING, IN_ESCAPE, IN_SCALAR,
+        SLASH, LINE_COMMENT, BLOCK_COMMENT, BLOCK_COMMENT_STAR
+    };
+    struct Pending;
+
+    bool in_value() const;
+    bool advance(size_t stop_at, Json & value);
+    void complete();
+    void fail(std::string && msg);
+
+    const JsonParse m_strategy;
+    State m_state;
+    std::vector<char> m_open;           // the brackets of the containers open in the scanner
+    std::string m_buf;                  // the value in progress, from where the parser stopped
+    size_t m_safe;                      // offset in m_buf the parser may run up to, or 0
+    std::unique_ptr<Pending> m_pending; // the containers the parser has open
+    std::vector<Json> m_ready;
+    size_t m_ready_pos;
+    std::string m_err;
+    bool m_failed;
+};
+
+/* JsonFreeQueue
+ *
+ * Moves the cost of freeing large values off a latency-sensitive thread. Values pushed onto
+ * the queue are released by whichever thread drains it, typically one kept for the purpose:
+ *
+ *     JsonFreeQueue frees;
+ *     std::thread reaper([&] { while (frees.wait_and_drain()) {} });
+ *     ...
+ *     frees.push(std::move(response));    // rather than letting it go out of scope
+ *     ...
+ *     frees.close();
+ *     reaper.join();
+ *
+ * push() only takes a lock and appends. Draining a value drops the queue's reference to it, as
+ * if it had gone out of scope there; parts still referenced elsewhere live on. Anything left
+ * queued is freed by the destructor. With JSON11_SINGLE_THREADED, only push values that
+ * nothing else refers to.
+ */
+class JsonFreeQueue final {
+public:
+    JsonFreeQueue();
+    ~JsonFreeQueue();
+    JsonFreeQueue(const JsonFreeQueue &) = delete;
+    JsonFreeQueue & operator=(const JsonFreeQueue &) = delete;
+
+    // Queue value to be freed, leaving it null.
+    void push(Json && value);
+
+    // Free everything queued so far, and return how many values that was.
+    size_t drain();
+
+    // Wait until a value is queued or the queue is closed, then drain it. Return false once
+    // the queue is closed and empty.
+    bool wait_and_drain();
+
+    // Stop wait_and_drain() from waiting any longer.
+    void close();
+
+private:
+    struct State;
+    std::unique_ptr<State> m_state;
+};
+
+// Internal class hierarchy - JsonValue objects are not exposed to users of this API. A node
+// has no virtual functions: the Json that points to it knows its type, and so which class it
+// is, except that strings and arrays come in two kinds each, which the node records.
 class JsonValue {
+public:
+    enum Kind : uint8_t {
+        STRING, STRING_REF, ARRAY, NUMBER_ARRAY, OBJECT
+    };
+    Kind kind() const { return m_kind; }
+
 protected:
     friend class Json;
-    friend class JsonInt;
-    friend class JsonDouble;
-    virtual Json::Type type() const = 0;
-    virtual bool equals(const JsonValue * other) const = 0;
-    virtual bool less(const JsonValue * other) const = 0;
-    virtual void dump(std::string &out) const = 0;
-    virtual double number_value() const;
-    virtual int int_value() const;
-    virtual bool bool_value() const;
-    virtual const std::string &string_value() const;
-    virtual const Json::array &array_items() const;
-    virtual const Json &operator[](size_t i) const;
-    virtual const Json::object &object_items() const;
-    virtual const Json &operator[](const std::string &key) const;
-    virtual ~JsonValue() {}
+    friend class JsonArena;
+    explicit JsonValue(Kind kind) : m_refs(1), m_kind(kind), m_in_arena(false) {}
+    JsonValue(const JsonValue &) = delete;
+    JsonValue & operator=(const JsonValue &) = delete;
+    ~JsonValue() {}
+
+private:
+    // Add a reference, or drop one and return whether it was the last.
+    // With libstdc++ the atomics are skipped, as std::shared_ptr does, until the process
+    // starts a second thread.
+    void retain() const noexcept {
+#if JSON11_SINGLE_THREADED
+        ++m_refs;
+#elif defined(__GLIBCXX__)
+        __gnu_cxx::__atomic_add_dispatch(&m_refs, 1);
+#else
+        m_refs.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+    bool release() const noexcept {
+#if JSON11_SINGLE_THREADED
+        return --m_refs == 0;
+#elif defined(__GLIBCXX__)
+        return __gnu_cxx::__exchange_and_add_dispatch(&m_refs, -1) == 1;
+#else
+        return m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+#endif
+    }
+
+    // Free a node whose last reference has been released, and whichever of its elements that
+    // leaves unreferenced. This doesn't recurse, so a tree of any depth can be freed.
+    static void destroy(JsonValue * node);
+
+#if JSON11_SINGLE_THREADED
+    mutable uint32_t m_refs;
+#elif defined(__GLIBCXX__)
+    mutable _Atomic_word m_refs;
+#else
+    mutable std::atomic<uint32_t> m_refs;
+#endif
+    const Kind m_kind;
+    bool m_in_arena; // allocated by a JsonArena, which frees it
 };
 
+inline Json::Json(const Json & other) noexcept : m_tag(other.m_tag), m_value(other.m_value) {
+    if (has_node())
+        m_value.node->retain();
+}
+
+inline Json & Json::operator=(const Json & other) noexcept {
+    if (other.has_node())
+        other.m_value.node->retain();
+    // Release the old node last: other may be one of its elements.
+    const bool had_node = has_node();
+    JsonValue * const old = m_value.node;
+    m_tag = other.m_tag;
+    m_value = other.m_value;
+    if (had_node && old->release())
+        JsonValue::destroy(old);
+    return *this;
+}
+
+inline Json & Json::operator=(Json && other) noexcept {
+    if (this != &other) {
+        const bool had_node = has_node();
+        JsonValue * const old = m_value.node;
+        m_tag = other.m_tag;
+        m_value = other.m_value;
+        other.m_tag = NUL;
+        if (had_node && old->release())
+            JsonValue::destroy(old);
+    }
+    return *this;
+}
+
+inline Json::~Json() {
+    if (has_node() && m_value.node->release())
+        JsonValue::destroy(m_value.node);
+}
+
 } // namespace json11
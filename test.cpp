@@ -30,7 +30,10 @@
  * Beginning of standard source file, which makes use of the customizations above.
  */
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
 #include <string>
+#include <limits>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
@@ -41,6 +44,7 @@
 #include <unordered_map>
 #include <algorithm>
 #include <type_traits>
+#include <clocale>
 
 // Insert user-defined prefix code (includes, function declarations, etc)
 // to set up a custom test suite
@@ -165,13 +169,64 @@ JSON11_TEST_CASE(json11_test) {
     std::cout << "obj: " << obj.dump() << "\n";
     JSON11_TEST_ASSERT(obj.dump() == "{\"k1\": \"v1\", \"k2\": 42, \"k3\": [\"a\", 123, true, false, null]}");
 
+    const char *key_pointer = "k2";
+    char key_array[] = "k1";
+    JSON11_TEST_ASSERT(obj[key_pointer] == 42 && obj[key_array] == "v1");
+    JSON11_TEST_ASSERT(obj[Json::string_ref("k3 and more", 2)] == obj[string("k3")]);
+    JSON11_TEST_ASSERT(obj[0].is_null() && obj["k3"][0] == "a");
+
+    // Prepared keys remember where they were last found; that guess must never be trusted.
+    const Json::Key k1("k1"), k3("k3"), missing("k4");
+    const Json reordered = Json::object({ { "k0", 0 }, { "k1", 1 }, { "k3", 3 } });
+    for (int round = 0; round < 2; round++) {
+        JSON11_TEST_ASSERT(obj[k1] == "v1" && obj[k3][1] == 123 && obj[missing].is_null());
+        JSON11_TEST_ASSERT(reordered[k1] == 1 && reordered[k3] == 3 && reordered[missing].is_null());
+    }
+    JSON11_TEST_ASSERT(Json::Key(k3).name() == "k3" && Json(5)[k1].is_null());
+
     JSON11_TEST_ASSERT(Json("a").number_value() == 0);
     JSON11_TEST_ASSERT(Json("a").string_value() == "a");
     JSON11_TEST_ASSERT(Json().number_value() == 0);
 
     JSON11_TEST_ASSERT(obj == json);
+    const Json repeated = Json::parse(R"({"b": 1, "a": 2, "b": 3})", err);
+    JSON11_TEST_ASSERT(repeated.dump() == R"({"a": 2, "b": 3})" && repeated["b"] == 3);
+    JSON11_TEST_ASSERT(repeated.object_items().size() == 2 && repeated["c"].is_null());
     JSON11_TEST_ASSERT(Json(42) == Json(42.0));
     JSON11_TEST_ASSERT(Json(42) != Json(42.1));
+    JSON11_TEST_ASSERT(Json(1) < Json(1.5) && Json(false) < Json(true) && Json() < Json(0));
+
+    Json moved_from = Json::array { "a", 1 };
+    Json moved_to = std::move(moved_from);
+    JSON11_TEST_ASSERT(moved_from.is_null() && moved_to[0] == "a");
+
+    {
+        Json::Document doc;
+        JSON11_TEST_ASSERT(doc.parse(simple_test, err) && doc.root() == json);
+        JSON11_TEST_ASSERT(!doc.parse("[\"a\", 1", err) && doc.root().is_null() && !err.empty());
+        // Reparsing reuses the arena, which grows by further blocks as needed.
+        const string big = Json(Json::array(5000, Json::array { "abc", Json::object {} })).dump();
+        JSON11_TEST_ASSERT(doc.parse(big, err) && doc.root().array_items().size() == 5000);
+        JSON11_TEST_ASSERT(doc.root() == Json::parse(big, err));
+    }
+
+    {
+        // Values kept from a document stay valid after it is reparsed or destroyed.
+        Json kept, kept_before_reparse;
+        JsonFreeQueue late_frees;
+        {
+            Json::Document doc;
+            JSON11_TEST_ASSERT(doc.parse(R"({"a": ["x", {"b": "yyyyyyyyyyyyyyyyyyyyyyyyy"}]})", err));
+            kept_before_reparse = doc.root()["a"];
+            JSON11_TEST_ASSERT(doc.parse(R"({"a": [1, "two"], "c": "three"})", err));
+            kept = doc.root()["a"];
+            Json queued = doc.root()["c"];
+            late_frees.push(std::move(queued));
+        }
+        JSON11_TEST_ASSERT(kept.dump() == R"([1, "two"])");
+        JSON11_TEST_ASSERT(kept_before_reparse[1]["b"] == "yyyyyyyyyyyyyyyyyyyyyyyyy");
+        JSON11_TEST_ASSERT(late_frees.drain() == 1);
+    }
 
     const string unicode_escape_test =
         R"([ "blah\ud83d\udca9blah\ud83dblah\udca9blah\u0000blah\u1234" ])";
@@ -183,6 +238,57 @@ JSON11_TEST_CASE(json11_test) {
     JSON11_TEST_ASSERT(uni[0].string_value().size() == (sizeof utf8) - 1);
     JSON11_TEST_ASSERT(std::memcmp(uni[0].string_value().data(), utf8, sizeof utf8) == 0);
 
+    const string long_plain(100, 'z');
+    Json long_string = Json::parse("\"" + long_plain + "\\t\\u00e9" + long_plain + "\"", err);
+    JSON11_TEST_ASSERT(long_string.string_value() == long_plain + "\t\xc3\xa9" + long_plain);
+    string control_err;
+    JSON11_TEST_ASSERT(Json::parse("\"" + long_plain + "\n\"", control_err).is_null());
+    JSON11_TEST_ASSERT(control_err == "unescaped (10) in string");
+    JSON11_TEST_ASSERT(Json(long_plain + "\"\x01\xe2\x80\xa8" + long_plain + "\xe2\x82\xac\xe2").dump()
+                       == "\"" + long_plain + "\\\"\\u0001\\u2028" + long_plain + "\xe2\x82\xac\xe2\"");
+
+    {
+        // Numbers are converted while they are scanned and must round exactly like strtod.
+        const char *numbers[] = {
+            "0.1", "-2.5e-3", "1e23", "9007199254740993", "2.2250738585072011e-308",
+            "4.9e-324", "1.7976931348623157e308", "123456789012345678901234567890e-10",
+            "0.000000000000000000000000000000000001e37", "1e-400",
+        };
+        for (const char *number : numbers) {
+            string number_err;
+            const double expected = std::strtod(number, nullptr);
+            JSON11_TEST_ASSERT(Json::parse(number, number_err).number_value() == expected);
+        }
+        JSON11_TEST_ASSERT(Json::parse("1e400", err).number_value() == HUGE_VAL);
+        JSON11_TEST_ASSERT(Json::parse("-123456789", err).number_value() == -123456789);
+
+        // A locale with a ',' decimal point must not change how numbers are read.
+        const char *comma_locales[] = { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "de_DE" };
+        for (const char *locale : comma_locales) {
+            if (std::setlocale(LC_NUMERIC, locale)) {
+                JSON11_TEST_ASSERT(Json::parse("[1.5, 2.25e0, 12345678901234567890.5]", err)
+                                   == Json(Json::array { 1.5, 2.25, 12345678901234567890.5 }));
+                std::setlocale(LC_NUMERIC, "C");
+                break;
+            }
+        }
+
+        // Doubles are written in the shortest form that reads back to the same value.
+        JSON11_TEST_ASSERT(Json(0.1).dump() == "0.1");
+        JSON11_TEST_ASSERT(Json(-2.5e-3).dump() == "-0.0025");
+        JSON11_TEST_ASSERT(Json(1e-5).dump() == "1e-05");
+        JSON11_TEST_ASSERT(Json(1e22).dump() == "1e+22");
+        JSON11_TEST_ASSERT(Json(123456.0).dump() == "123456");
+        JSON11_TEST_ASSERT(Json(5e-324).dump() == "5e-324");
+        JSON11_TEST_ASSERT(Json(NAN).dump() == "null");
+        JSON11_TEST_ASSERT(Json(Json::array { 0, 7, -42, 100, 2147483647, -2147483647 - 1 }).dump()
+                           == "[0, 7, -42, 100, 2147483647, -2147483648]");
+        for (const char *number : numbers) {
+            const double value = std::strtod(number, nullptr);
+            JSON11_TEST_ASSERT(Json::parse(Json(value).dump(), err).number_value() == value);
+        }
+    }
+
     // Demonstrates the behavior change in Xcode 7 / Clang 3.7, introduced by DR1467
     // and described here: https://llvm.org/bugs/show_bug.cgi?id=23812
     if (JSON11_ENABLE_DR1467_CANARY) {
@@ -250,6 +356,494 @@ JSON11_TEST_CASE(json11_test) {
     JSON11_TEST_ASSERT(((Json)(Json::object { { "foo", 1234567 } })).has_shape({ { "foo", Json::NUL } }, err) == false);
     JSON11_TEST_ASSERT(((Json)(Json::object { { "bar", 1234567 } })).has_shape({ { "foo", Json::NUL } }, err) == false);
 
+    {
+        // Records every event as a compact token stream.
+        struct RecordingHandler : JsonHandler {
+            string events;
+            bool on_null() override { events += "n "; return true; }
+            bool on_bool(bool b) override { events += b ? "t " : "f "; return true; }
+            bool on_number(double d) override { events += Json(d).dump() + " "; return true; }
+            bool on_string(const string &s) override { events += "s:" + s + " "; return true; }
+            bool on_start_object() override { events += "{ "; return true; }
+            bool on_key(const string &k) override { events += "k:" + k + " "; return true; }
+            bool on_end_object() override { events += "} "; return true; }
+            bool on_start_array() override { events += "[ "; return true; }
+            bool on_end_array() override { events += "] "; return true; }
+        } handler;
+        JSON11_TEST_ASSERT(Json::sax_parse(simple_test, handler, err));
+        JSON11_TEST_ASSERT(handler.events ==
+            "{ k:k1 s:v1 k:k2 42 k:k3 [ s:a 123 t f n ] } ");
+
+        // Stops after the first key is seen.
+        struct FirstKeyHandler : JsonHandler {
+            string key;
+            bool on_key(const string &k) override { key = k; return false; }
+        } first_key;
+        string sax_err;
+        JSON11_TEST_ASSERT(!Json::sax_parse(simple_test, first_key, sax_err));
+        JSON11_TEST_ASSERT(first_key.key == "k1");
+        JSON11_TEST_ASSERT(!sax_err.empty());
+
+        JsonHandler ignore;
+        JSON11_TEST_ASSERT(!Json::sax_parse("[1, 2", ignore, sax_err));
+        JSON11_TEST_ASSERT(Json::sax_parse("[1, /* two */ 2]", ignore, sax_err, JsonParse::COMMENTS));
+    }
+
+    {
+        const string records = R"([{"id": 1, "tags": ["x", {"y": []}], "name": "a"},
+                                    {"id": 2, "name": "b"}])";
+        JsonReader reader(records);
+        JSON11_TEST_ASSERT(reader.next() == JsonReader::START_ARRAY);
+        std::vector<string> names;
+        double id_sum = 0;
+        while (reader.next() == JsonReader::START_OBJECT) {
+            while (reader.next() == JsonReader::KEY) {
+                if (reader.string_value() == "id") {
+                    double id;
+                    JSON11_TEST_ASSERT(reader.read_number(id));
+                    id_sum += id;
+                } else if (reader.string_value() == "name") {
+                    string name;
+                    JSON11_TEST_ASSERT(reader.read_string(name));
+                    names.push_back(name);
+                } else {
+                    JSON11_TEST_ASSERT(reader.skip_value());
+                }
+            }
+            JSON11_TEST_ASSERT(reader.token() == JsonReader::END_OBJECT);
+        }
+        JSON11_TEST_ASSERT(reader.token() == JsonReader::END_ARRAY);
+        JSON11_TEST_ASSERT(reader.next() == JsonReader::END);
+        JSON11_TEST_ASSERT(reader.error().empty());
+        JSON11_TEST_ASSERT(id_sum == 3);
+        JSON11_TEST_ASSERT(names == std::vector<string>({ "a", "b" }));
+
+        JsonReader value_reader(simple_test);
+        JSON11_TEST_ASSERT(value_reader.read_value() == json);
+        JSON11_TEST_ASSERT(value_reader.next() == JsonReader::END);
+
+        const string bad_list = "[1, 2} ";
+        JsonReader bad_reader(bad_list);
+        JSON11_TEST_ASSERT(bad_reader.next() == JsonReader::START_ARRAY);
+        JSON11_TEST_ASSERT(!bad_reader.skip_value());
+        JSON11_TEST_ASSERT(bad_reader.next() == JsonReader::FAILED);
+        JSON11_TEST_ASSERT(!bad_reader.error().empty());
+
+        const string two_values = "1 2";
+        JsonReader trailing_reader(two_values);
+        bool flag;
+        JSON11_TEST_ASSERT(!trailing_reader.read_bool(flag));
+        JSON11_TEST_ASSERT(trailing_reader.error() == "expected bool");
+
+        const string big_numbers = "[1e100, -1e100, 2.9, -2.9]";
+        JsonReader clamp_reader(big_numbers);
+        JSON11_TEST_ASSERT(clamp_reader.next() == JsonReader::START_ARRAY);
+        JSON11_TEST_ASSERT(clamp_reader.next() == JsonReader::NUMBER);
+        JSON11_TEST_ASSERT(clamp_reader.int_value() == std::numeric_limits<int>::max());
+        JSON11_TEST_ASSERT(clamp_reader.next() == JsonReader::NUMBER);
+        JSON11_TEST_ASSERT(clamp_reader.int_value() == std::numeric_limits<int>::min());
+        JSON11_TEST_ASSERT(clamp_reader.next() == JsonReader::NUMBER);
+        JSON11_TEST_ASSERT(clamp_reader.int_value() == 2);
+        JSON11_TEST_ASSERT(clamp_reader.next() == JsonReader::NUMBER);
+        JSON11_TEST_ASSERT(clamp_reader.int_value() == -2);
+
+        // read_value() keeps ints as ints, as Json::parse does.
+        struct IsInt {
+            bool operator()(std::nullptr_t) const { return false; }
+            bool operator()(bool) const { return false; }
+            bool operator()(int) const { return true; }
+            bool operator()(double) const { return false; }
+            bool operator()(Json::string_ref) const { return false; }
+            bool operator()(const Json::array &) const { return false; }
+            bool operator()(Json::object_ref) const { return false; }
+        };
+        const string mixed_numbers = "[1, 2.5, -7]";
+        JsonReader int_reader(mixed_numbers);
+        const Json read = int_reader.read_value();
+        const Json parsed = Json::parse(mixed_numbers, err);
+        JSON11_TEST_ASSERT(read == parsed);
+        JSON11_TEST_ASSERT(read[0].visit(IsInt()) && parsed[0].visit(IsInt()));
+        JSON11_TEST_ASSERT(!read[1].visit(IsInt()) && !parsed[1].visit(IsInt()));
+        JSON11_TEST_ASSERT(read[2].visit(IsInt()) && read[2].int_value() == -7);
+    }
+
+    {
+        // Feed a stream of values one byte at a time, as the worst case of split frames.
+        const string stream_input = simple_test + "\n[1, \"}\\\"]\"]" + " -12.5e1 \"s\"{} 3";
+        JsonStreamParser stream;
+        std::vector<Json> values;
+        Json value;
+        for (char ch : stream_input) {
+            JSON11_TEST_ASSERT(stream.feed(&ch, 1));
+            while (stream.next(value))
+                values.push_back(value);
+        }
+        JSON11_TEST_ASSERT(values.size() == 5);
+        JSON11_TEST_ASSERT(stream.finish());
+        while (stream.next(value))
+            values.push_back(value);
+        string multi_err;
+        JSON11_TEST_ASSERT(values == Json::parse_multi(stream_input, multi_err));
+        JSON11_TEST_ASSERT(values.size() == 6);
+
+        JsonStreamParser comment_stream(JsonParse::COMMENTS);
+        JSON11_TEST_ASSERT(comment_stream.feed("/* lead */ {\"a\": /* ] */ 1} // tail\n 7"));
+        JSON11_TEST_ASSERT(comment_stream.finish());
+        JSON11_TEST_ASSERT(comment_stream.next(value) && value["a"] == Json(1));
+        JSON11_TEST_ASSERT(comment_stream.next(value) && value == Json(7));
+        JSON11_TEST_ASSERT(!comment_stream.next(value));
+
+        JsonStreamParser bad_stream;
+        JSON11_TEST_ASSERT(!bad_stream.feed("[1, 2}"));
+        JSON11_TEST_ASSERT(!bad_stream.error().empty());
+
+        JsonStreamParser short_stream;
+        JSON11_TEST_ASSERT(short_stream.feed("{\"a\": [1"));
+        JSON11_TEST_ASSERT(!short_stream.finish());
+
+        // Values are parsed as far as possible at the end of each chunk, so an error shows up
+        // before the value it is in is complete.
+        JsonStreamParser early_stream;
+        JSON11_TEST_ASSERT(!early_stream.feed("[[1 2], 3"));
+        JSON11_TEST_ASSERT(early_stream.error() == "expected ',' in list, got '2' (50)");
+
+        // Chunks of every size up to the input, splitting keys, numbers and comments.
+        const string nested = R"({"k1": [1, 22, {"k2": "a,b:c", "k3": [[], {}, -3.5e2]}],
+                                  /* , : */ "k4": {"k5": [true, false, null, "\"]"]}} 44)";
+        string nested_err;
+        const auto nested_values = Json::parse_multi(nested, nested_err, JsonParse::COMMENTS);
+        JSON11_TEST_ASSERT(nested_values.size() == 2);
+        for (size_t chunk = 1; chunk <= nested.size(); chunk++) {
+            JsonStreamParser chunked(JsonParse::COMMENTS);
+            std::vector<Json> chunked_values;
+            for (size_t pos = 0; pos < nested.size(); pos += chunk) {
+                JSON11_TEST_ASSERT(chunked.feed(nested.substr(pos, chunk)));
+                while (chunked.next(value))
+                    chunked_values.push_back(value);
+            }
+            JSON11_TEST_ASSERT(chunked.finish());
+            while (chunked.next(value))
+                chunked_values.push_back(value);
+            JSON11_TEST_ASSERT(chunked_values == nested_values);
+        }
+    }
+
+    {
+        // Runs of whitespace of every length, including ones that reach the end of the input,
+        // are skipped wherever whitespace may appear.
+        const Json expected = Json::array { 1, Json::object { { "a", Json::array {} } } };
+        for (size_t n = 0; n <= 40; n++) {
+            string ws;
+            for (size_t k = 0; k < n; k++)
+                ws += " \t\r\n   "[k % 7];
+            string err;
+            const string pretty = ws + "[" + ws + "1" + ws + "," + ws + "{" + ws + "\"a\"" + ws
+                                  + ":" + ws + "[" + ws + "]" + ws + "}" + ws + "]" + ws;
+            JSON11_TEST_ASSERT(Json::parse(pretty, err) == expected);
+            JSON11_TEST_ASSERT(err.empty());
+            Json::parse(ws + "1" + ws + "x", err);
+            JSON11_TEST_ASSERT(err == "unexpected trailing 'x' (120)");
+        }
+    }
+
+    {
+        // Objects above the threshold are hash-indexed; lookups and output must not change.
+        ParseOptions hashed;
+        hashed.object_index_threshold = 8;
+        Json::object table;
+        for (int i = 0; i < 1000; i++)
+            table["key" + std::to_string(i * 7)] = i;
+        const string table_json = Json(table).dump();
+        const Json wide = Json::parse(table_json, err, hashed);
+        JSON11_TEST_ASSERT(wide.dump() == table_json && wide == Json(table));
+        for (int i = 0; i < 1000; i++)
+            JSON11_TEST_ASSERT(wide["key" + std::to_string(i * 7)] == i);
+        JSON11_TEST_ASSERT(wide["key1"].is_null() && wide[""].is_null());
+        JSON11_TEST_ASSERT(wide.has_shape({ { "key7", Json::NUMBER } }, err));
+        static const std::pair<Json::string_ref, Json::Type> fields[] = {
+            { "key7", Json::NUMBER }, { "key14", Json::NUMBER } };
+        JSON11_TEST_ASSERT(wide.has_shape(fields, err));
+        static const std::pair<Json::string_ref, Json::Type> bad_fields[] = {
+            { "key7", Json::NUMBER }, { "key8", Json::NUMBER } };
+        JSON11_TEST_ASSERT(!wide.has_shape(bad_fields, err) && err.find("key8") != string::npos);
+        const Json unindexed = Json(table);
+        for (int i = 0; i < 1000; i += 37) {
+            const Json::Key key("key" + std::to_string(i * 7));
+            JSON11_TEST_ASSERT(wide[key] == i && unindexed[key] == i && wide[key] == i);
+        }
+        JSON11_TEST_ASSERT(wide[Json::Key("key1")].is_null() && unindexed[Json::Key("")].is_null());
+    }
+
+    {
+        // Zero-copy strings must behave exactly like copied ones, and outlive the input.
+        ParseOptions zero_copy;
+        zero_copy.zero_copy_strings = true;
+        const string long_text(40, 'v');
+        string input = "{\"" + long_text + "\": [\"" + long_text + "\", \"short\", \""
+                       + long_text + "\\n\", \"\"]}";
+        const Json copied = Json::parse(input, err);
+        const Json viewed = Json::parse(input, err, zero_copy);
+        input.assign(input.size(), 'x');
+        JSON11_TEST_ASSERT(viewed == copied && viewed.dump() == copied.dump());
+        const Json &values = viewed[long_text];
+        JSON11_TEST_ASSERT(values[0].string_ref_value().str() == long_text);
+        JSON11_TEST_ASSERT(values[0].string_value() == long_text && values[0] < values[2]);
+        JSON11_TEST_ASSERT(values[2].string_value() == long_text + "\n");
+        JSON11_TEST_ASSERT(Json(long_text) == values[0] && !(values[0] < Json(long_text)));
+        JSON11_TEST_ASSERT(Json(5).string_ref_value().size == 0);
+
+        const auto shared = std::make_shared<const string>("[\"" + long_text + "\"]");
+        JSON11_TEST_ASSERT(Json::parse(shared, err, zero_copy)[0].string_ref_value().data
+                           == shared->data() + 2);
+    }
+
+    {
+        // Interned keys (only long ones are) must outlive the rest of the parse.
+        ParseOptions interned;
+        interned.intern_keys = true;
+        const string long_key = "a_field_name_too_long_to_fit_inline";
+        const string input = "[{\"" + long_key + "\": 1, \"id\": 2},"
+                             " {\"id\": 3, \"" + long_key + "\": 4, \"" + long_key + "\\u0021\": 5},"
+                             " {\"" + long_key + "\": {\"" + long_key + "\": 6}}]";
+        Json record;
+        {
+            const Json records = Json::parse(input, err, interned);
+            JSON11_TEST_ASSERT(records == Json::parse(input, err));
+            JSON11_TEST_ASSERT(records.dump() == Json::parse(input, err).dump());
+            record = records[1];
+        }
+        JSON11_TEST_ASSERT(record[long_key] == 4 && record[long_key + "!"] == 5);
+        JSON11_TEST_ASSERT(record.object_items().begin()->first == long_key);
+        const Json built = Json::object { { long_key, 1 }, { long_key + "!", 2 } };
+        JSON11_TEST_ASSERT(built[long_key] == 1);
+        JSON11_TEST_ASSERT(Json::parse(built.dump(), err, interned) == built);
+    }
+
+    {
+        // Deduplicated values are shared between equal subtrees, and otherwise unchanged.
+        ParseOptions deduped;
+        deduped.dedupe_values = true;
+        const string input = "[{\"host\": \"db\", \"ports\": [1, 2], \"tls\": {}},"
+                             " {\"host\": \"db\", \"ports\": [1, 2], \"tls\": {}},"
+                             " {\"host\": \"db\", \"ports\": [1, 2.0], \"tls\": []}, \"db\"]";
+        const Json plain = Json::parse(input, err);
+        for (const Json &shared : { Json::parse(input, err, deduped), plain.dedupe() }) {
+            JSON11_TEST_ASSERT(shared == plain && shared.dump() == plain.dump());
+            JSON11_TEST_ASSERT(&shared[0].object_items() == &shared[1].object_items());
+            JSON11_TEST_ASSERT(&shared[0]["ports"].array_items()
+                               != &shared[2]["ports"].array_items());
+            JSON11_TEST_ASSERT(shared[0]["host"].string_ref_value().data
+                               == shared[3].string_ref_value().data);
+        }
+        JSON11_TEST_ASSERT(&plain[0].object_items() != &plain[1].object_items());
+        JSON11_TEST_ASSERT(Json(5).dedupe() == 5 && Json().dedupe().is_null());
+
+        // An object made from a map keeps it for object_items(), and its long keys are views
+        // of the map's keys. A deduplicated copy has keys of its own.
+        const string long_key(40, 'k');
+        Json rebuilt;
+        {
+            const Json::object members { { long_key, Json::array { 1, 2 } },
+                                         { "b", Json::array { 1, 2 } } };
+            const Json made = members;
+            JSON11_TEST_ASSERT(made.object_items() == members && made[long_key] == members.at("b"));
+            rebuilt = made.dedupe();
+        }
+        JSON11_TEST_ASSERT(&rebuilt[long_key].array_items() == &rebuilt["b"].array_items());
+        JSON11_TEST_ASSERT(rebuilt.dump() == "{\"b\": [1, 2], \"" + long_key + "\": [1, 2]}");
+    }
+
+    {
+        // Copies share nodes, which live until the last copy is released or reassigned.
+        Json first = Json::array { "x", Json::object { { "k", "v" } } };
+        Json second = first;
+        const Json &alias = second;
+        second = alias;
+        JSON11_TEST_ASSERT(&second.array_items() == &first.array_items());
+        first = Json("y");
+        Json third = second[1];
+        second = first;
+        JSON11_TEST_ASSERT(third["k"] == "v" && second == "y" && first.string_value() == "y");
+        third = std::move(second);
+        JSON11_TEST_ASSERT(third == "y" && second.is_null());
+        // Assigning a value its own element keeps the element alive past the old node.
+        Json nested = Json::array { Json::array { "inner", 2 } };
+        nested = nested[0];
+        JSON11_TEST_ASSERT(nested[0] == "inner" && nested[1].int_value() == 2);
+        Json &same = nested;
+        nested = std::move(same);
+        JSON11_TEST_ASSERT(nested[0] == "inner");
+    }
+
+    {
+        // visit() calls the overload for the type held; objects are walked in key order.
+        struct Describe {
+            string operator()(std::nullptr_t) const { return "null"; }
+            string operator()(bool value) const { return value ? "T" : "F"; }
+            string operator()(int value) const { return "i" + std::to_string(value); }
+            string operator()(double value) const { return "d" + std::to_string(value); }
+            string operator()(Json::string_ref value) const { return "'" + value.str() + "'"; }
+            string operator()(const Json::array &items) const {
+                string out = "[";
+                for (const Json &item : items)
+                    out += item.visit(*this) + " ";
+                return out + "]";
+            }
+            string operator()(Json::object_ref members) const {
+                string out = "{";
+                for (size_t i = 0; i < members.size(); i++)
+                    out += members.key(i).str() + "=" + members.value(i).visit(*this) + " ";
+                return out + "}";
+            }
+        };
+        const Json value = Json::parse(R"({"b": [1, 2.5, true, null], "a": "x", "c": {}})", err);
+        JSON11_TEST_ASSERT(value.visit(Describe())
+                           == "{a='x' b=[i1 d2.500000 T null ] c={} }");
+        JSON11_TEST_ASSERT(Json(2.0).visit(Describe()) == "d2.000000");
+        JSON11_TEST_ASSERT(Json("s").object_ref_value().size() == 0);
+    }
+
+    {
+        // Nesting is bounded by ParseOptions::max_depth, not by the native stack.
+        const string deep = string(3000, '[') + string(3000, ']');
+        JSON11_TEST_ASSERT(Json::parse(deep, err).is_null());
+        JSON11_TEST_ASSERT(err == "exceeded maximum nesting depth");
+        ParseOptions deeper;
+        deeper.max_depth = 2998;
+        JSON11_TEST_ASSERT(Json::parse(deep, err, deeper).is_null() && !err.empty());
+        deeper.max_depth = 2999;
+        string deep_err;
+        const Json nested = Json::parse(deep, deep_err, deeper);
+        JSON11_TEST_ASSERT(deep_err.empty() && nested.dump() == deep);
+
+        string objects;
+        for (int i = 0; i < 1000; i++)
+            objects += "{\"k\": [" + std::to_string(i) + ", ";
+        objects += "null";
+        for (int i = 0; i < 1000; i++)
+            objects += "], \"n\": " + std::to_string(i) + "}";
+        const Json outer = Json::parse(objects, deep_err, deeper);
+        const Json *level = &outer;
+        for (int i = 0; i < 1000; i++) {
+            JSON11_TEST_ASSERT((*level)["k"][0] == i && (*level)["n"] == 999 - i);
+            level = &(*level)["k"][1];
+        }
+        JSON11_TEST_ASSERT(deep_err.empty() && level->is_null());
+    }
+
+    {
+        // Freeing doesn't recurse either, however deep the tree, and takes in the copies held
+        // by object_items().
+        Json arrays;
+        for (int i = 0; i < 300000; i++)
+            arrays = Json::array { arrays, "x" };
+        JSON11_TEST_ASSERT(arrays[1] == "x" && arrays[0][0][1] == "x");
+        arrays = Json();
+
+        Json objects;
+        for (int i = 0; i < 300000; i++) {
+            objects = Json::object { { "k", objects }, { "n", i } };
+            JSON11_TEST_ASSERT(objects.object_items().size() == 2);
+        }
+        const Json kept = objects["k"]["k"];
+        objects = Json();
+        JSON11_TEST_ASSERT(kept["n"] == 299997 && kept["k"]["n"] == 299996);
+    }
+
+    {
+        // JsonFreeQueue frees values when drained, not when pushed.
+        JsonFreeQueue frees;
+        Json list = Json::array { "a", Json::object { { "b", 1 } } };
+        const Json copy = list;
+        frees.push(std::move(list));
+        frees.push(Json("c"));
+        JSON11_TEST_ASSERT(list.is_null() && copy[1]["b"] == 1);
+        JSON11_TEST_ASSERT(frees.drain() == 2 && frees.drain() == 0);
+        JSON11_TEST_ASSERT(copy.dump() == R"(["a", {"b": 1}])");
+
+        frees.push(Json::array { 1, 2 });
+        frees.close();
+        JSON11_TEST_ASSERT(frees.wait_and_drain() && !frees.wait_and_drain());
+        frees.push(Json("left for the destructor"));
+    }
+
+    {
+        // Long arrays of numbers are parsed into contiguous doubles, and read like any array.
+        string input = "[";
+        for (int i = 0; i < 20; i++)
+            input += (i ? ", " : "") + (i % 3 ? std::to_string(i) : std::to_string(i) + ".5");
+        input += "]";
+        ParseOptions as_json;
+        as_json.number_array_threshold = 0;
+        const Json numbers = Json::parse(input, err);
+        const Json elements = Json::parse(input, err, as_json);
+        const Json::number_span span = numbers.number_span_value();
+        JSON11_TEST_ASSERT(span.size == 20 && span[0] == 0.5 && span[19] == 19);
+        JSON11_TEST_ASSERT(elements.number_span_value().size == 0);
+        JSON11_TEST_ASSERT(numbers.dump() == elements.dump() && numbers == elements);
+        JSON11_TEST_ASSERT(!(numbers < elements) && !(elements < numbers));
+        JSON11_TEST_ASSERT(numbers[1].dump() == "1" && numbers[3] == 3.5);
+        JSON11_TEST_ASSERT(numbers[20].is_null());
+        JSON11_TEST_ASSERT(numbers.array_items() == elements.array_items());
+        JSON11_TEST_ASSERT(Json(numbers).number_span_value().data == span.data);
+
+        const string with_string = input.substr(0, input.size() - 1) + ", \"x\"]";
+        JSON11_TEST_ASSERT(Json::parse(with_string, err).number_span_value().size == 0);
+        JSON11_TEST_ASSERT(Json::parse("[1, 2, 3]", err).number_span_value().size == 0);
+        const Json later = Json::parse(input.substr(0, input.size() - 1) + ", 21]", err);
+        JSON11_TEST_ASSERT(numbers < later && later.number_span_value().size == 21);
+
+        ParseOptions deduped;
+        deduped.dedupe_values = true;
+        const Json pair = Json::parse("[" + input + ", " + input + "]", err, deduped);
+        JSON11_TEST_ASSERT(pair[0].number_span_value().data == pair[1].number_span_value().data);
+    }
+
+    {
+        // operator[] and visit() read an array of contiguous doubles without array_items().
+        string input = "[";
+        for (int i = 0; i < 200; i++)
+            input += (i ? ", " : "") + (i % 2 ? std::to_string(i) : std::to_string(i) + ".5");
+        input += "]";
+        ParseOptions as_json;
+        as_json.number_array_threshold = 0;
+        const Json numbers = Json::parse(input, err);
+        const Json elements = Json::parse(input, err, as_json);
+        JSON11_TEST_ASSERT(numbers[0] == 0.5 && numbers[1].dump() == "1" && numbers[199] == 199);
+        JSON11_TEST_ASSERT(&numbers[150] == &numbers[150] && numbers[200].is_null());
+        JSON11_TEST_ASSERT(numbers == elements && !(numbers < elements));
+        const Json last = Json::parse(input.substr(0, input.size() - 4) + "200]", err);
+        JSON11_TEST_ASSERT(elements < last && !(last < elements) && last != elements);
+
+        struct Sum {
+            double operator()(std::nullptr_t) const { return 0; }
+            double operator()(bool) const { return 0; }
+            double operator()(int value) const { return value; }
+            double operator()(double value) const { return value; }
+            double operator()(Json::string_ref) const { return 0; }
+            double operator()(Json::number_span values) const {
+                double sum = 0;
+                for (double value : values)
+                    sum += value;
+                return -sum;
+            }
+            double operator()(const Json::array &items) const {
+                double sum = 0;
+                for (const Json &item : items)
+                    sum += item.visit(*this);
+                return sum;
+            }
+            double operator()(Json::object_ref) const { return 0; }
+        };
+        // The number_span overload, which negates here, is only called for contiguous doubles.
+        const double sum = 100 * 199 + 50;
+        JSON11_TEST_ASSERT(numbers.visit(Sum()) == -sum && elements.visit(Sum()) == sum);
+
+        // After all that, array_items() still builds the same elements, and operator[] then
+        // answers from it.
+        JSON11_TEST_ASSERT(numbers.array_items() == elements.array_items());
+        JSON11_TEST_ASSERT(&numbers[7] == &numbers.array_items()[7]);
+    }
 }
 
 #if JSON11_TEST_STANDALONE_MAIN